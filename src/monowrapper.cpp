@@ -1,6 +1,7 @@
 /* Mono includes */
 #include <mono/jit/jit.h>
 #include <mono/metadata/assembly.h>
+#include <mono/metadata/attrdefs.h>
 #include <mono/metadata/class.h>
 #include <mono/metadata/debug-helpers.h>
 #include <mono/metadata/loader.h>
@@ -16,6 +17,17 @@
 #include <assert.h>
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MONOWRAPPER_SSE2 1
+#endif
+
 #ifndef ASSERT
 #define ASSERT(x) assert(x)
 #endif
@@ -25,10 +37,6 @@ using namespace mono;
 struct _MonoProfiler
 {
 	MonoProfilerHandle handle;
-	uint64_t totalAllocs;
-	uint64_t totalMoves;
-	uint64_t bytesMoved;
-	uint64_t bytesAlloc;
 	mono::ManagedScriptSystem* scriptsys;
 };
 
@@ -47,6 +55,34 @@ static void Profiler_ContextUnloaded(MonoProfiler* prof, MonoAppContext* ctx);
 static void Profiler_GCEvent(MonoProfiler* prof, MonoProfilerGCEvent ev, uint32_t gen, mono_bool isSerial);
 static void Profiler_GCAlloc(MonoProfiler* prof, MonoObject* obj);
 static void Profiler_GCResize(MonoProfiler* prof, uintptr_t size);
+static void Profiler_AssemblyLoaded(MonoProfiler* prof, MonoAssembly* ass);
+static void Profiler_AssemblyUnloading(MonoProfiler* prof, MonoAssembly* ass);
+static void Profiler_SampleHit(MonoProfiler* prof, const mono_byte* ip, const void* context);
+static MonoProfilerCallInstrumentationFlags Profiler_CallFilter(MonoProfiler* prof, MonoMethod* method);
+static void Profiler_MethodEnter(MonoProfiler* prof, MonoMethod* method, MonoProfilerCallContext* context);
+static void Profiler_MethodLeave(MonoProfiler* prof, MonoMethod* method, MonoProfilerCallContext* context);
+static void Profiler_MethodExceptionLeave(MonoProfiler* prof, MonoMethod* method, MonoObject* exc);
+static void Profiler_ThreadStarted(MonoProfiler* prof, uintptr_t tid);
+static void Profiler_ThreadExited(MonoProfiler* prof, uintptr_t tid);
+
+/* Cache for FindSystemClass, keyed on namespace then class name. Shared by all contexts since they
+ * live in the same domain. Misses are cached as nullptr until another assembly is loaded */
+static std::mutex g_systemClassLock;
+static std::unordered_map<std::string, std::unordered_map<std::string, MonoClass*>> g_systemClasses;
+
+/* Images of assemblies loaded through a script context. Only these are instrumented */
+static std::mutex g_scriptImageLock;
+static std::unordered_set<MonoImage*> g_scriptImages;
+
+static void RegisterScriptImage(MonoImage* img) {
+	std::lock_guard<std::mutex> lock(g_scriptImageLock);
+	g_scriptImages.insert(img);
+}
+
+static void UnregisterScriptImage(MonoImage* img) {
+	std::lock_guard<std::mutex> lock(g_scriptImageLock);
+	g_scriptImages.erase(img);
+}
 
 //================================================================//
 //
@@ -55,14 +91,23 @@ static void Profiler_GCResize(MonoProfiler* prof, uintptr_t size);
 //================================================================//
 ManagedAssembly::ManagedAssembly(ManagedScriptContext* ctx, const std::string& name, MonoImage* img, MonoAssembly* ass)
 	: m_ctx(ctx), m_path(name), m_image(img), m_assembly(ass), m_populated(false) {
+	RegisterScriptImage(img);
 }
 
 void ManagedAssembly::PopulateReflectionInfo() {
 	if (m_populated)
 		return;
 	m_populated = true;
+	/* Classes are looked up on demand */
+	if (m_ctx->m_lazyReflection)
+		return;
 	const MonoTableInfo* tab = mono_image_get_table_info(m_image, MONO_TABLE_TYPEDEF);
 	int rows = mono_table_info_get_rows(tab);
+	int numThreads = m_ctx->m_reflectionThreads;
+	if (numThreads > 1 && rows >= numThreads * 2) {
+		PopulateReflectionInfoParallel(tab, rows, numThreads);
+		return;
+	}
 	for (int i = 0; i < rows; i++) {
 		uint32_t cols[MONO_TYPEDEF_SIZE];
 		mono_metadata_decode_row(tab, i, cols, MONO_TYPEDEF_SIZE);
@@ -72,6 +117,66 @@ void ManagedAssembly::PopulateReflectionInfo() {
 	}
 }
 
+/* Splits the TYPEDEF rows between worker threads attached to the runtime. Workers only read the
+ * context's class index and assemblies, the new classes are added on this thread once they're all
+ * done. Rows that FindClass would resolve in an earlier assembly, or not at all, are handed to
+ * FindClass here so both paths create the same classes */
+void ManagedAssembly::PopulateReflectionInfoParallel(const MonoTableInfo* tab, int rows, int numThreads) {
+	std::vector<std::vector<ManagedClass*>> results(numThreads);
+	std::vector<std::vector<std::pair<const char*, const char*>>> deferred(numThreads);
+	std::vector<std::thread> workers;
+	int perThread = (rows + numThreads - 1) / numThreads;
+
+	for (int t = 0; t < numThreads; t++) {
+		workers.emplace_back([this, tab, rows, perThread, t, &results, &deferred]() {
+			MonoThread* thread = mono_thread_attach(m_ctx->m_domain);
+			int end = std::min(rows, (t + 1) * perThread);
+			for (int i = t * perThread; i < end; i++) {
+				uint32_t cols[MONO_TYPEDEF_SIZE];
+				mono_metadata_decode_row(tab, i, cols, MONO_TYPEDEF_SIZE);
+				const char* ns = mono_metadata_string_heap(m_image, cols[MONO_TYPEDEF_NAMESPACE]);
+				const char* c = mono_metadata_string_heap(m_image, cols[MONO_TYPEDEF_NAME]);
+
+				/* Already indexed */
+				if (m_ctx->m_classIndex.count(ManagedScriptContext::ClassKey(ns, c)))
+					continue;
+
+				/* FindClass searches the assemblies in load order */
+				bool earlier = false;
+				for (auto* a : m_ctx->m_loadedAssemblies) {
+					if (a == this)
+						break;
+					if (a && mono_class_from_name(a->m_image, ns, c)) {
+						earlier = true;
+						break;
+					}
+				}
+
+				MonoClass* monoClass = earlier ? nullptr : mono_class_from_name(m_image, ns, c);
+				if (monoClass)
+					results[t].push_back(m_arena.New<ManagedClass>(this, monoClass));
+				else
+					deferred[t].push_back({ns, c});
+			}
+			mono_thread_detach(thread);
+		});
+	}
+	for (auto& w : workers)
+		w.join();
+
+	for (auto& list : results) {
+		for (auto klass : list) {
+			m_classes.insert({klass->m_namespaceName, klass});
+			const std::string& key = ManagedScriptContext::ClassKey(klass->m_namespaceName, klass->m_className);
+			m_ctx->m_classIndex.emplace(key, klass);
+		}
+	}
+	for (auto& list : deferred) {
+		for (auto& row : list)
+			m_ctx->FindClass(row.first, row.second);
+	}
+}
+
 /* NOTE: No info is cached here because it should be called sparingly! */
 void ManagedAssembly::GetReferencedTypes(std::vector<std::string>& refList) {
 	const MonoTableInfo* tab = mono_image_get_table_info(m_image, MONO_TABLE_TYPEREF);
@@ -88,6 +193,24 @@ void ManagedAssembly::GetReferencedTypes(std::vector<std::string>& refList) {
 	}
 }
 
+void ManagedAssembly::GetDefinedTypes(std::vector<std::string>& typeList) {
+	const MonoTableInfo* tab = mono_image_get_table_info(m_image, MONO_TABLE_TYPEDEF);
+	int rows = mono_table_info_get_rows(tab);
+	for (int i = 0; i < rows; i++) {
+		uint32_t cols[MONO_TYPEDEF_SIZE];
+		mono_metadata_decode_row(tab, i, cols, MONO_TYPEDEF_SIZE);
+		const char* ns = mono_metadata_string_heap(m_image, cols[MONO_TYPEDEF_NAMESPACE]);
+		const char* n = mono_metadata_string_heap(m_image, cols[MONO_TYPEDEF_NAME]);
+		char type[512];
+		snprintf(type, sizeof(type), "%s.%s", ns, n);
+		typeList.push_back((const char*)type);
+	}
+}
+
+int ManagedAssembly::NumDefinedTypes() const {
+	return mono_table_info_get_rows(mono_image_get_table_info(m_image, MONO_TABLE_TYPEDEF));
+}
+
 bool ManagedAssembly::ValidateAgainstWhitelist(const std::vector<std::string>& whiteList) {
 	std::vector<std::string> refTypes;
 	this->GetReferencedTypes(refTypes);
@@ -106,10 +229,9 @@ bool ManagedAssembly::ValidateAgainstWhitelist(const std::vector<std::string>& w
 }
 
 void ManagedAssembly::DisposeReflectionInfo() {
-	for (auto& kvPair : m_classes) {
-		delete kvPair.second;
-	}
+	m_ctx->RemoveIndexedClasses(*this);
 	m_classes.clear();
+	m_arena.Reset();
 }
 
 void ManagedAssembly::Unload() {
@@ -124,8 +246,49 @@ void ManagedAssembly::InvalidateHandle() {
 	}
 }
 
-void ManagedAssembly::ReportException(MonoObject* exc) {
-	m_ctx->ReportException(*exc, *this);
+void ManagedAssembly::ReportException(MonoObject* exc, MonoMethod* method) {
+	m_ctx->ReportException(*exc, *this, method);
+}
+
+//================================================================//
+//
+// Reflection Arena
+//
+//================================================================//
+
+void* ReflectionArena::Allocate(size_t size, size_t align) {
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	size_t pad = (align - ((uintptr_t)m_cur & (align - 1))) & (align - 1);
+	if (!m_cur || pad + size > m_remaining) {
+		/* Oversized objects get a block to themselves */
+		size_t blockSize = std::max(BLOCK_SIZE, size + align);
+		char* block = static_cast<char*>(malloc(blockSize));
+		ASSERT(block);
+		m_blocks.push_back(block);
+		m_cur = block;
+		m_remaining = blockSize;
+		pad = (align - ((uintptr_t)m_cur & (align - 1))) & (align - 1);
+	}
+
+	void* mem = m_cur + pad;
+	m_cur += pad + size;
+	m_remaining -= pad + size;
+	return mem;
+}
+
+void ReflectionArena::Reset() {
+	std::lock_guard<std::mutex> lock(m_lock);
+	for (auto it = m_destructors.rbegin(); it != m_destructors.rend(); ++it) {
+		it->destroy(it->object);
+	}
+	m_destructors.clear();
+	for (auto block : m_blocks) {
+		free(block);
+	}
+	m_blocks.clear();
+	m_cur = nullptr;
+	m_remaining = 0;
 }
 
 //================================================================//
@@ -160,7 +323,8 @@ const std::string& ManagedType::Name() const {
 //
 //================================================================//
 
-ManagedMethod::ManagedMethod(MonoMethod* method, ManagedClass* cls) : m_populated(false) {
+ManagedMethod::ManagedMethod(MonoMethod* method, ManagedClass* cls)
+	: m_signature(nullptr), m_populated(false), m_thunk(nullptr) {
 	if (!method)
 		return;
 	m_method = method;
@@ -171,22 +335,18 @@ ManagedMethod::ManagedMethod(MonoMethod* method, ManagedClass* cls) : m_populate
 		m_signature = mono_method_get_signature(m_method, m_class->m_assembly->m_image, m_token);
 		ASSERT(m_signature);
 	}
+	if (!m_signature)
+		m_signature = mono_method_signature(m_method);
 
 	m_name = mono_method_get_name(m_method);
 	m_paramCount = mono_signature_get_param_count(m_signature);
 
-	m_returnType = new ManagedType(mono_signature_get_return_type(m_signature));
+	m_returnType = m_class->m_assembly->m_arena.New<ManagedType>(mono_signature_get_return_type(m_signature));
 }
 
 ManagedMethod::~ManagedMethod() {
 	if (m_attrInfo)
 		mono_custom_attrs_free(m_attrInfo);
-	if (m_returnType)
-		delete m_returnType;
-	for (auto x : m_params) {
-		delete x;
-	}
-	m_params.clear();
 }
 
 ManagedAssembly& ManagedMethod::Assembly() const {
@@ -264,12 +424,142 @@ bool ManagedMethod::MatchSignature() {
 	return mono_signature_get_param_count(m_signature) == 0;
 }
 
+/* Compares a single managed type against the native type it's passed as */
+static bool MatchNativeType(MonoType* type, const NativeTypeDesc_t& desc) {
+	if (mono_type_is_byref(type))
+		return desc.type == MONO_TYPE_PTR;
+
+	int t = mono_type_get_type(type);
+
+	/* Enums are passed as their underlying type */
+	if (t == MONO_TYPE_VALUETYPE) {
+		MonoClass* cls = mono_type_get_class(type);
+		if (cls && mono_class_is_enum(cls))
+			t = mono_type_get_type(mono_class_enum_basetype(cls));
+	}
+
+	switch (desc.type) {
+	case MONO_TYPE_PTR:
+		return mono_type_is_reference(type) || t == MONO_TYPE_PTR || t == MONO_TYPE_FNPTR || t == MONO_TYPE_I ||
+			   t == MONO_TYPE_U;
+	case MONO_TYPE_VALUETYPE:
+		if (t != MONO_TYPE_VALUETYPE && !(t == MONO_TYPE_GENERICINST && !mono_type_is_reference(type)))
+			return false;
+		return mono_class_value_size(mono_class_from_mono_type(type), nullptr) == (int32_t)desc.size;
+	case MONO_TYPE_U1:
+		return t == MONO_TYPE_U1 || t == MONO_TYPE_BOOLEAN;
+	case MONO_TYPE_U2:
+		return t == MONO_TYPE_U2 || t == MONO_TYPE_CHAR;
+	case MONO_TYPE_I4:
+	case MONO_TYPE_U4:
+	case MONO_TYPE_I8:
+	case MONO_TYPE_U8:
+		/* Native sized integers can be passed as IntPtr/UIntPtr */
+		if ((t == MONO_TYPE_I || t == MONO_TYPE_U) && desc.size == sizeof(void*))
+			return true;
+		return t == desc.type;
+	default:
+		return t == desc.type;
+	}
+}
+
+MonoClass* NativeTypeClass(const NativeTypeDesc_t& desc) {
+	switch (desc.type) {
+	case MONO_TYPE_BOOLEAN:
+		return mono_get_boolean_class();
+	case MONO_TYPE_CHAR:
+		return mono_get_char_class();
+	case MONO_TYPE_I1:
+		return mono_get_sbyte_class();
+	case MONO_TYPE_U1:
+		return mono_get_byte_class();
+	case MONO_TYPE_I2:
+		return mono_get_int16_class();
+	case MONO_TYPE_U2:
+		return mono_get_uint16_class();
+	case MONO_TYPE_I4:
+		return mono_get_int32_class();
+	case MONO_TYPE_U4:
+		return mono_get_uint32_class();
+	case MONO_TYPE_I8:
+		return mono_get_int64_class();
+	case MONO_TYPE_U8:
+		return mono_get_uint64_class();
+	case MONO_TYPE_R4:
+		return mono_get_single_class();
+	case MONO_TYPE_R8:
+		return mono_get_double_class();
+	default:
+		return nullptr;
+	}
+}
+
+bool ManagedMethod::MatchArraySignature(const NativeTypeDesc_t* types, size_t count, MonoClass** classes) const {
+	if (!m_signature || count != (size_t)m_paramCount)
+		return false;
+	if (mono_type_get_type(mono_signature_get_return_type(m_signature)) != MONO_TYPE_VOID)
+		return false;
+
+	void* iter = nullptr;
+	MonoType* type = nullptr;
+	size_t i = 0;
+	while ((type = mono_signature_get_params(m_signature, &iter))) {
+		if (mono_type_is_byref(type) || mono_type_get_type(type) != MONO_TYPE_SZARRAY)
+			return false;
+		MonoClass* elem = mono_class_get_element_class(mono_class_from_mono_type(type));
+		if (!MatchElementClass(elem, types[i]))
+			return false;
+		classes[i++] = elem;
+	}
+	return true;
+}
+
+bool ManagedMethod::MatchNativeSignature(const NativeTypeDesc_t* types, size_t count, MonoClass** classes) const {
+	if (!m_signature || count != (size_t)m_paramCount + 1)
+		return false;
+
+	auto match = [types, classes](MonoType* type, size_t i) {
+		if (!MatchNativeType(type, types[i]))
+			return false;
+		if (classes)
+			classes[i] = types[i].type == MONO_TYPE_VALUETYPE ? mono_class_from_mono_type(type) : nullptr;
+		return true;
+	};
+
+	if (!match(mono_signature_get_return_type(m_signature), 0))
+		return false;
+
+	void* iter = nullptr;
+	MonoType* type = nullptr;
+	size_t i = 1;
+	while ((type = mono_signature_get_params(m_signature, &iter))) {
+		if (!match(type, i))
+			return false;
+		i++;
+	}
+	return true;
+}
+
+bool ManagedMethod::IsStatic() const {
+	return !mono_signature_is_instance(m_signature);
+}
+
+void* ManagedMethod::UnmanagedThunk() {
+	if (!m_thunk)
+		m_thunk = mono_method_get_unmanaged_thunk(m_method);
+	return m_thunk;
+}
+
+void ManagedMethod::ReportException(MonoObject* exc) {
+	m_class->m_assembly->ReportException(exc, m_method);
+}
+
 MonoObject* ManagedMethod::Invoke(ManagedObject* obj, void** params, MonoObject** _exc) {
 	MonoObject* exception = nullptr;
 	MonoObject* o = mono_runtime_invoke(m_method, obj->RawObject(), params, _exc ? _exc : &exception);
 
 	if (exception) {
-		m_class->m_assembly->ReportException(exception);
+		m_class->m_assembly->ReportException(exception, m_method);
 		return nullptr;
 	}
 	return o;
@@ -280,7 +570,7 @@ MonoObject* ManagedMethod::InvokeStatic(void** params, MonoObject** _exc) {
 	MonoObject* o = mono_runtime_invoke(m_method, nullptr, params, _exc ? _exc : &exception);
 
 	if (exception) {
-		m_class->m_assembly->ReportException(exception);
+		m_class->m_assembly->ReportException(exception, m_method);
 		return nullptr;
 	}
 	return o;
@@ -293,13 +583,210 @@ MonoObject* ManagedMethod::InvokeStatic(void** params, MonoObject** _exc) {
 //================================================================//
 
 ManagedField::ManagedField(MonoClassField& fld, ManagedClass& cls) : m_class(cls), m_field(fld) {
-	const char* n = mono_field_get_name(&fld);
-	m_name = n;
+	m_name = mono_field_get_name(&fld);
 }
 
 ManagedField::~ManagedField() {
 }
 
+/* Checks the instance fields of a struct for references, including nested structs */
+static bool ClassHasReferences(MonoClass* cls) {
+	void* iter = nullptr;
+	MonoClassField* field;
+	while ((field = mono_class_get_fields(cls, &iter))) {
+		if (mono_field_get_flags(field) & MONO_FIELD_ATTR_STATIC)
+			continue;
+		MonoType* type = mono_field_get_type(field);
+		if (mono_type_is_reference(type))
+			return true;
+		if (mono_type_is_struct(type)) {
+			MonoClass* fieldClass = mono_class_from_mono_type(type);
+			if (fieldClass != cls && ClassHasReferences(fieldClass))
+				return true;
+		}
+	}
+	return false;
+}
+
+bool ManagedField::IsStatic() const {
+	return mono_field_get_flags(&m_field) & MONO_FIELD_ATTR_STATIC;
+}
+
+bool ManagedField::HasReferences() const {
+	MonoType* type = RawType();
+	if (mono_type_is_reference(type))
+		return true;
+	if (mono_type_is_struct(type))
+		return ClassHasReferences(mono_class_from_mono_type(type));
+	return false;
+}
+
+bool ManagedField::MatchNativeType(const NativeTypeDesc_t& desc) const {
+	return mono::MatchNativeType(RawType(), desc);
+}
+
+bool MatchElementClass(MonoClass* elem, const NativeTypeDesc_t& desc) {
+	/* Pointer elements are copied with reference write barriers, anything else with memcpy */
+	if (desc.type == MONO_TYPE_PTR)
+		return !mono_class_is_valuetype(elem);
+	if (!mono_class_is_valuetype(elem) || ClassHasReferences(elem))
+		return false;
+	return mono::MatchNativeType(mono_class_get_type(elem), desc);
+}
+
+bool MatchArrayElementType(MonoArray* array, const NativeTypeDesc_t& desc) {
+	return MatchElementClass(mono_class_get_element_class(mono_object_get_class((MonoObject*)array)), desc);
+}
+
+//================================================================//
+//
+// String helpers
+//
+//================================================================//
+
+size_t Utf16ToUtf8(const char16_t* in, size_t length, char* out, size_t outSize) {
+	size_t i = 0;
+	size_t o = 0;
+	while (i < length) {
+#ifdef MONOWRAPPER_SSE2
+		/* ASCII fast path, 8 code units at a time */
+		while (i + 8 <= length && o + 8 <= outSize) {
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+			/* Any unit with bits above 0x7F set isn't ASCII */
+			__m128i high = _mm_and_si128(chunk, _mm_set1_epi16((short)0xFF80));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) != 0xFFFF)
+				break;
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(out + o), _mm_packus_epi16(chunk, chunk));
+			i += 8;
+			o += 8;
+		}
+		if (i >= length)
+			break;
+#endif
+		uint32_t c = in[i];
+		size_t consumed = 1;
+		if (c >= 0xD800 && c <= 0xDBFF && i + 1 < length && in[i + 1] >= 0xDC00 && in[i + 1] <= 0xDFFF) {
+			c = 0x10000 + ((c - 0xD800) << 10) + (in[i + 1] - 0xDC00);
+			consumed = 2;
+		} else if (c >= 0xD800 && c <= 0xDFFF) {
+			c = 0xFFFD;
+		}
+
+		if (c < 0x80) {
+			if (o + 1 > outSize)
+				break;
+			out[o++] = (char)c;
+		} else if (c < 0x800) {
+			if (o + 2 > outSize)
+				break;
+			out[o++] = (char)(0xC0 | (c >> 6));
+			out[o++] = (char)(0x80 | (c & 0x3F));
+		} else if (c < 0x10000) {
+			if (o + 3 > outSize)
+				break;
+			out[o++] = (char)(0xE0 | (c >> 12));
+			out[o++] = (char)(0x80 | ((c >> 6) & 0x3F));
+			out[o++] = (char)(0x80 | (c & 0x3F));
+		} else {
+			if (o + 4 > outSize)
+				break;
+			out[o++] = (char)(0xF0 | (c >> 18));
+			out[o++] = (char)(0x80 | ((c >> 12) & 0x3F));
+			out[o++] = (char)(0x80 | ((c >> 6) & 0x3F));
+			out[o++] = (char)(0x80 | (c & 0x3F));
+		}
+		i += consumed;
+	}
+	return o;
+}
+
+size_t StringToUtf8(MonoString* str, char* out, size_t outSize) {
+	if (!outSize)
+		return 0;
+	std::u16string_view chars = StringChars(str);
+	size_t len = Utf16ToUtf8(chars.data(), chars.size(), out, outSize - 1);
+	out[len] = 0;
+	return len;
+}
+
+std::string_view StringToUtf8(MonoString* str) {
+	thread_local std::vector<char> buffer;
+	std::u16string_view chars = StringChars(str);
+	if (buffer.size() < chars.size() * 3 + 1)
+		buffer.resize(chars.size() * 3 + 1);
+	size_t len = StringToUtf8(str, buffer.data(), buffer.size());
+	return {buffer.data(), len};
+}
+
+//================================================================//
+//
+// Managed Exception Desc
+//
+//================================================================//
+
+const std::string& ManagedExceptionDesc::GetString(uint8_t field, MonoMethod* getter, std::string& out) const {
+	if (m_loaded & field)
+		return out;
+	m_loaded |= field;
+
+	if (!Valid() || !getter)
+		return out;
+
+	MonoObject* exc = nullptr;
+	MonoObject* value = mono_runtime_invoke(getter, m_exception, nullptr, &exc);
+	if (value && !exc)
+		out = StringToUtf8(mono_object_to_string(value, nullptr));
+	return out;
+}
+
+const std::string& ManagedExceptionDesc::Message() const {
+	return GetString(MESSAGE, m_class ? m_class->messageGetter : nullptr, m_message);
+}
+
+const std::string& ManagedExceptionDesc::StackTrace() const {
+	return GetString(STACK_TRACE, m_class ? m_class->stackTraceGetter : nullptr, m_stackTrace);
+}
+
+const std::string& ManagedExceptionDesc::Source() const {
+	return GetString(SOURCE, m_class ? m_class->sourceGetter : nullptr, m_source);
+}
+
+const std::string& ManagedExceptionDesc::StringRep() const {
+	if (m_loaded & STRING_REP)
+		return m_stringRep;
+	m_loaded |= STRING_REP;
+
+	if (!Valid())
+		return m_stringRep;
+
+	MonoObject* pexc = nullptr;
+	MonoString* str = mono_object_to_string(m_exception, &pexc);
+	if (!pexc && str)
+		m_stringRep = StringToUtf8(str);
+	return m_stringRep;
+}
+
+const char* ManagedExceptionDesc::ClassName() const {
+	return Valid() ? mono_class_get_name(mono_object_get_class(m_exception)) : "";
+}
+
+const char* ManagedExceptionDesc::Namespace() const {
+	return Valid() ? mono_class_get_namespace(mono_object_get_class(m_exception)) : "";
+}
+
+ManagedException_t ManagedExceptionDesc::Materialize() const {
+	ManagedException_t exc;
+	if (!Valid())
+		return exc;
+	exc.message = Message();
+	exc.source = Source();
+	exc.stackTrace = StackTrace();
+	exc.klass = ClassName();
+	exc.ns = Namespace();
+	exc.string_rep = StringRep();
+	return exc;
+}
+
 //================================================================//
 //
 // Managed Property
@@ -307,8 +794,7 @@ ManagedField::~ManagedField() {
 //================================================================//
 
 ManagedProperty::ManagedProperty(MonoProperty& prop, ManagedClass& cls) : m_class(cls), m_property(&prop) {
-	const char* n = mono_property_get_name(m_property);
-	m_name = n;
+	m_name = mono_property_get_name(m_property);
 	m_getMethod = mono_property_get_get_method(m_property);
 	m_setMethod = mono_property_get_set_method(m_property);
 }
@@ -316,6 +802,30 @@ ManagedProperty::ManagedProperty(MonoProperty& prop, ManagedClass& cls) : m_clas
 ManagedProperty::~ManagedProperty() {
 }
 
+ManagedMethod* ManagedProperty::GetMethod() const {
+	return m_getMethod ? m_class.FindMethod(m_getMethod) : nullptr;
+}
+
+ManagedMethod* ManagedProperty::SetMethod() const {
+	return m_setMethod ? m_class.FindMethod(m_setMethod) : nullptr;
+}
+
+ManagedField* ManagedProperty::BackingField() const {
+	for (MonoMethod* method : {m_getMethod, m_setMethod}) {
+		if (!method)
+			continue;
+		uint32_t flags = mono_method_get_flags(method, nullptr);
+		if ((flags & MONO_METHOD_ATTR_VIRTUAL) && !(flags & MONO_METHOD_ATTR_FINAL))
+			return nullptr;
+	}
+
+	/* Angle brackets aren't allowed in C# names, so this can only be the generated field */
+	std::string name;
+	name.reserve(m_name.size() + 18);
+	name.append("<").append(m_name).append(">k__BackingField");
+	return m_class.FindField(name);
+}
+
 //================================================================//
 //
 // Managed Class
@@ -323,41 +833,17 @@ ManagedProperty::~ManagedProperty() {
 //================================================================//
 
 ManagedClass::ManagedClass(ManagedAssembly* assembly, const std::string& ns, const std::string& cls)
-	: m_assembly(assembly), m_className(cls), m_namespaceName(ns), m_populated(false), m_numConstructors(0) {
+	: m_assembly(assembly), m_populated(false), m_numConstructors(0), m_attrInfo(nullptr) {
 	m_class = mono_class_from_name(m_assembly->m_image, ns.c_str(), cls.c_str());
 	if (!m_class) {
 		return;
 	}
-	m_attrInfo = mono_custom_attrs_from_class(m_class);
-
-	/* If there is no class name or namespace, something is fucky */
-	if (!cls.empty() && m_attrInfo) {
-		if (mono_custom_attrs_has_attr(m_attrInfo, m_class)) {
-			auto obj = mono_custom_attrs_get_attr(m_attrInfo, m_class);
-			if (!obj)
-				return;
-			m_attributes.push_back(new ManagedObject(obj, *this));
-		}
-	}
 
 	PopulateReflectionInfo();
 }
 
-ManagedClass::ManagedClass(ManagedAssembly* assembly, MonoClass* _cls, const std::string& ns, const std::string& cls)
-	: m_className(cls), m_class(_cls), m_namespaceName(ns), m_populated(false), m_assembly(assembly),
-	  m_numConstructors(0) {
-	m_attrInfo = mono_custom_attrs_from_class(m_class);
-
-	/* If there is no class name or namespace, something is fucky */
-	if (!cls.empty() && m_attrInfo) {
-		if (mono_custom_attrs_has_attr(m_attrInfo, m_class)) {
-			auto obj = mono_custom_attrs_get_attr(m_attrInfo, m_class);
-			if (!obj)
-				return;
-			m_attributes.push_back(new ManagedObject(obj, *this));
-		}
-	}
-
+ManagedClass::ManagedClass(ManagedAssembly* assembly, MonoClass* _cls)
+	: m_class(_cls), m_populated(false), m_assembly(assembly), m_numConstructors(0), m_attrInfo(nullptr) {
 	PopulateReflectionInfo();
 }
 
@@ -367,11 +853,8 @@ ManagedClass::~ManagedClass() {
 }
 
 void ManagedClass::PopulateReflectionInfo() {
-	ASSERT(!m_valid);
-	if (m_valid)
-		return;
-	void* iter = nullptr;
-
+	m_className = mono_class_get_name(m_class);
+	m_namespaceName = mono_class_get_namespace(m_class);
 	m_valueClass = mono_class_is_valuetype(m_class);
 	m_enumClass = mono_class_is_enum(m_class);
 	m_delegateClass = mono_class_is_delegate(m_class);
@@ -379,27 +862,52 @@ void ManagedClass::PopulateReflectionInfo() {
 	m_size = mono_class_instance_size(m_class);
 	m_alignment = mono_class_min_align(m_class);
 
+	if (!m_assembly->m_ctx->m_lazyReflection)
+		PopulateMembers();
+}
+
+/* Creates the attributes, methods, fields and properties of the class */
+void ManagedClass::PopulateMembers() {
+	if (m_populated)
+		return;
+	m_populated = true;
+
+	m_attrInfo = mono_custom_attrs_from_class(m_class);
+
+	/* If there is no class name or namespace, something is fucky */
+	if (!m_className.empty() && m_attrInfo) {
+		if (mono_custom_attrs_has_attr(m_attrInfo, m_class)) {
+			auto obj = mono_custom_attrs_get_attr(m_attrInfo, m_class);
+			if (obj)
+				m_attributes.push_back(new ManagedObject(obj, *this));
+		}
+	}
+
+	void* iter = nullptr;
 	MonoMethod* method;
 	while ((method = mono_class_get_methods(m_class, &iter))) {
 		if (strcmp(mono_method_get_name(method), ".ctor") == 0)
 			m_numConstructors++;
-		m_methods.push_back(new ManagedMethod(method, this));
+		m_methods.push_back(m_assembly->m_arena.New<ManagedMethod>(method, this));
 	}
 
 	MonoClassField* field;
 	iter = nullptr;
 	while ((field = mono_class_get_fields(m_class, &iter))) {
-		m_fields.push_back(new ManagedField(*field, *this));
+		m_fields.push_back(m_assembly->m_arena.New<ManagedField>(*field, *this));
 	}
 
 	MonoProperty* props;
 	iter = nullptr;
 	while ((props = mono_class_get_properties(m_class, &iter))) {
-		m_properties.push_back(new ManagedProperty(*props, *this));
+		m_properties.push_back(m_assembly->m_arena.New<ManagedProperty>(*props, *this));
 	}
 
-	m_populated = true;
+	m_methodIndex.Build(m_methods);
+	m_fieldIndex.Build(m_fields);
+	m_propertyIndex.Build(m_properties);
 }
+
 void ManagedClass::InvalidateHandle() {
 	ManagedBase<ManagedClass>::InvalidateHandle();
 	for (auto& attr : m_attributes) {
@@ -410,34 +918,33 @@ void ManagedClass::InvalidateHandle() {
 	}
 }
 
-// TODO: Investigate perf of this, maybe use a hashmap? Might just be faster to
-// not though.
-ManagedMethod* ManagedClass::FindMethod(const std::string& name) {
-	for (auto m : m_methods) {
-		if (m->m_name == name)
-			return m;
-	}
-	return nullptr;
+ManagedMethod* ManagedClass::FindMethod(std::string_view name) {
+	EnsureMembers();
+	return m_methodIndex.Find(name);
 }
 
-ManagedField* ManagedClass::FindField(const std::string& name) {
-	for (auto& f : m_fields) {
-		if (f->m_name == name)
-			return f;
-	}
-	return nullptr;
+ManagedField* ManagedClass::FindField(std::string_view name) {
+	EnsureMembers();
+	return m_fieldIndex.Find(name);
+}
+
+ManagedProperty* ManagedClass::FindProperty(std::string_view prop) {
+	EnsureMembers();
+	return m_propertyIndex.Find(prop);
 }
 
-ManagedProperty* ManagedClass::FindProperty(const std::string& prop) {
-	for (auto& p : m_properties) {
-		if (p->m_name == prop)
-			return p;
+ManagedMethod* ManagedClass::FindMethod(MonoMethod* method) {
+	EnsureMembers();
+	for (auto m : m_methods) {
+		if (m->m_method == method)
+			return m;
 	}
 	return nullptr;
 }
 
 /* Creates an instance of a this class */
 ManagedObject* ManagedClass::CreateInstance(std::vector<MonoType*> signature, void** params) {
+	EnsureMembers();
 	for (auto& method : m_methods) {
 		if (method->m_name == ".ctor" && method->MatchSignature(signature)) {
 			MonoObject* exception = nullptr;
@@ -459,6 +966,7 @@ ManagedObject* ManagedClass::CreateInstance(std::vector<MonoType*> signature, vo
 }
 
 mono_byte ManagedClass::NumConstructors() const {
+	EnsureMembers();
 	return m_numConstructors;
 }
 
@@ -543,18 +1051,20 @@ bool ManagedClass::IsBool() {
 ManagedObject::ManagedObject(MonoObject* obj, ManagedClass& cls, EManagedObjectHandleType type) {
 	m_obj = obj;
 	m_class = &cls;
+	m_handleType = type;
 	switch (type) {
 	case EManagedObjectHandleType::HANDLE:
 		m_gcHandle = mono_gchandle_new(obj, false);
-		m_getObject = [this]() -> MonoObject* { return mono_gchandle_get_target(this->m_gcHandle); };
 		break;
 	case EManagedObjectHandleType::HANDLE_PINNED:
 		m_gcHandle = mono_gchandle_new(obj, true);
-		m_getObject = [this]() -> MonoObject* { return this->m_obj; };
 		break;
 	case EManagedObjectHandleType::WEAKREF:
 		m_gcHandle = mono_gchandle_new_weakref(obj, false);
-		m_getObject = [this]() -> MonoObject* { return mono_gchandle_get_target(this->m_gcHandle); };
+		break;
+	case EManagedObjectHandleType::POOLED:
+		m_gcHandle = GCHandlePool::Acquire(obj);
+		m_slot = GCHandlePool::SlotAddress(m_gcHandle);
 		break;
 	default:
 		break;
@@ -562,7 +1072,47 @@ ManagedObject::ManagedObject(MonoObject* obj, ManagedClass& cls, EManagedObjectH
 }
 
 ManagedObject::~ManagedObject() {
-	mono_gchandle_free(m_gcHandle);
+	if (m_handleType == EManagedObjectHandleType::POOLED)
+		GCHandlePool::Release(m_gcHandle);
+	else
+		mono_gchandle_free(m_gcHandle);
+}
+
+/* Free list of ManagedObject sized blocks. Blocks are carved out of larger chunks and are never
+ * returned to the system, so creating and destroying objects doesn't go through malloc */
+static std::mutex g_objectFreeListLock;
+static void* g_objectFreeList = nullptr;
+static constexpr size_t OBJECT_CHUNK_SIZE = 256;
+
+void* ManagedObject::operator new(size_t size) {
+	if (size != sizeof(ManagedObject))
+		return ::operator new(size);
+
+	std::lock_guard<std::mutex> lock(g_objectFreeListLock);
+	if (!g_objectFreeList) {
+		char* chunk = static_cast<char*>(::operator new(sizeof(ManagedObject) * OBJECT_CHUNK_SIZE));
+		for (size_t i = 0; i < OBJECT_CHUNK_SIZE; i++) {
+			void* block = chunk + i * sizeof(ManagedObject);
+			*static_cast<void**>(block) = g_objectFreeList;
+			g_objectFreeList = block;
+		}
+	}
+	void* block = g_objectFreeList;
+	g_objectFreeList = *static_cast<void**>(block);
+	return block;
+}
+
+void ManagedObject::operator delete(void* ptr, size_t size) {
+	if (!ptr)
+		return;
+	if (size != sizeof(ManagedObject)) {
+		::operator delete(ptr);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(g_objectFreeListLock);
+	*static_cast<void**>(ptr) = g_objectFreeList;
+	g_objectFreeList = ptr;
 }
 
 bool ManagedObject::SetProperty(ManagedProperty& prop, void* value) {
@@ -606,40 +1156,24 @@ bool ManagedObject::GetField(ManagedField& prop, void* outValue) {
 	return true;
 }
 
-bool ManagedObject::SetProperty(const std::string& p, void* value) {
-	for (auto prop : m_class->m_properties) {
-		if (p == prop->m_name) {
-			return this->SetProperty(*prop, value);
-		}
-	}
-	return false;
+bool ManagedObject::SetProperty(std::string_view p, void* value) {
+	ManagedProperty* prop = m_class->FindProperty(p);
+	return prop ? this->SetProperty(*prop, value) : false;
 }
 
-bool ManagedObject::SetField(const std::string& p, void* value) {
-	for (auto& f : m_class->m_fields) {
-		if (f->m_name == p) {
-			return this->SetField(*f, value);
-		}
-	}
-	return false;
+bool ManagedObject::SetField(std::string_view p, void* value) {
+	ManagedField* f = m_class->FindField(p);
+	return f ? this->SetField(*f, value) : false;
 }
 
-bool ManagedObject::GetProperty(const std::string& p, void** outValue) {
-	for (auto& prop : m_class->m_properties) {
-		if (prop->m_name == p) {
-			return this->GetProperty(*prop, outValue);
-		}
-	}
-	return false;
+bool ManagedObject::GetProperty(std::string_view p, void** outValue) {
+	ManagedProperty* prop = m_class->FindProperty(p);
+	return prop ? this->GetProperty(*prop, outValue) : false;
 }
 
-bool ManagedObject::GetField(const std::string& p, void* outValue) {
-	for (auto& f : m_class->m_fields) {
-		if (f->m_name == p) {
-			return this->GetField(*f, outValue);
-		}
-	}
-	return false;
+bool ManagedObject::GetField(std::string_view p, void* outValue) {
+	ManagedField* f = m_class->FindField(p);
+	return f ? this->GetField(*f, outValue) : false;
 }
 
 MonoObject* ManagedObject::Invoke(struct ManagedMethod* method, void** params) {
@@ -648,24 +1182,173 @@ MonoObject* ManagedObject::Invoke(struct ManagedMethod* method, void** params) {
 
 //================================================================//
 //
-// Managed Script Context
+// Object Ref
 //
 //================================================================//
 
-ManagedScriptContext::ManagedScriptContext(const std::string& baseImage) : m_baseImage(baseImage) {
-}
+ObjectRef ObjectRef::Acquire(MonoObject* obj, EManagedObjectHandleType type) {
+	ObjectRef ref;
+	if (!obj)
+		return ref;
 
-ManagedScriptContext::~ManagedScriptContext() {
-	for (auto& a : m_loadedAssemblies) {
-		if (a->m_image)
-			mono_image_close(a->m_image);
-		if (a->m_assembly)
-			mono_assembly_close(a->m_assembly);
+	switch (type) {
+	case EManagedObjectHandleType::HANDLE:
+		ref.m_handle = mono_gchandle_new(obj, false);
+		break;
+	case EManagedObjectHandleType::HANDLE_PINNED:
+		ref.m_handle = mono_gchandle_new(obj, true);
+		break;
+	case EManagedObjectHandleType::WEAKREF:
+		ref.m_handle = mono_gchandle_new_weakref(obj, false);
+		break;
+	case EManagedObjectHandleType::POOLED:
+		ref.m_handle = GCHandlePool::Acquire(obj);
+		break;
+	default:
+		return ref;
 	}
+	ref.m_type = (uint32_t)type;
+	return ref;
 }
 
-bool ManagedScriptContext::Init() {
-	// m_domain = mono_domain_create_appdomain("abcd", nullptr);
+void ObjectRef::Release() {
+	if (!Valid())
+		return;
+	if (HandleType() == EManagedObjectHandleType::POOLED)
+		GCHandlePool::Release(m_handle);
+	else
+		mono_gchandle_free(m_handle);
+	*this = ObjectRef();
+}
+
+MonoObject* ObjectRef::Resolve() const {
+	if (!Valid())
+		return nullptr;
+	if (HandleType() == EManagedObjectHandleType::POOLED)
+		return *GCHandlePool::SlotAddress(m_handle);
+	return mono_gchandle_get_target(m_handle);
+}
+
+ManagedObject* ObjectRef::CreateManagedObject(ManagedClass& cls, EManagedObjectHandleType type) const {
+	MonoObject* obj = Resolve();
+	if (!obj)
+		return nullptr;
+	return new ManagedObject(obj, cls, type);
+}
+
+//================================================================//
+//
+// GC Handle Pool
+//
+//================================================================//
+
+struct GCHandleSlab_t
+{
+	uint32_t gcHandle; // Pins the array, so slot addresses never change
+	MonoArray* array;
+};
+
+/* Fixed size so SlotAddress can read it without the lock. Slabs are published by bumping
+ * g_numHandleSlabs after they're filled in */
+static std::mutex g_handlePoolLock;
+static GCHandleSlab_t g_handleSlabs[GCHandlePool::MAX_SLABS];
+static std::atomic<uint32_t> g_numHandleSlabs{0};
+static std::vector<uint32_t> g_freeHandleSlots;
+
+/* Must be called with g_handlePoolLock held */
+static void AddHandleSlab() {
+	uint32_t index = g_numHandleSlabs.load(std::memory_order_relaxed);
+	if (index >= GCHandlePool::MAX_SLABS) {
+		printf("GC handle pool exhausted!\n");
+		ASSERT(0);
+		abort();
+	}
+
+	MonoArray* array = mono_array_new(g_jitDomain, mono_get_object_class(), GCHandlePool::SLAB_SIZE);
+	ASSERT(array);
+	g_handleSlabs[index] = {mono_gchandle_new((MonoObject*)array, true), array};
+	g_numHandleSlabs.store(index + 1, std::memory_order_release);
+
+	/* Pushed in reverse so slots are handed out in order */
+	uint32_t first = index * GCHandlePool::SLAB_SIZE;
+	for (uint32_t i = GCHandlePool::SLAB_SIZE; i > 0; i--) {
+		g_freeHandleSlots.push_back(first + i - 1);
+	}
+}
+
+uint32_t GCHandlePool::Acquire(MonoObject* obj) {
+	std::lock_guard<std::mutex> lock(g_handlePoolLock);
+	if (g_freeHandleSlots.empty())
+		AddHandleSlab();
+
+	uint32_t slot = g_freeHandleSlots.back();
+	g_freeHandleSlots.pop_back();
+
+	GCHandleSlab_t& slab = g_handleSlabs[slot / SLAB_SIZE];
+	void* addr = mono_array_addr_with_size(slab.array, sizeof(MonoObject*), slot % SLAB_SIZE);
+	mono_gc_wbarrier_set_arrayref(slab.array, addr, obj);
+	return slot;
+}
+
+void GCHandlePool::Release(uint32_t slot) {
+	std::lock_guard<std::mutex> lock(g_handlePoolLock);
+	/* The slab is already gone after Shutdown */
+	if (slot / SLAB_SIZE >= g_numHandleSlabs.load(std::memory_order_relaxed))
+		return;
+	GCHandleSlab_t& slab = g_handleSlabs[slot / SLAB_SIZE];
+	void* addr = mono_array_addr_with_size(slab.array, sizeof(MonoObject*), slot % SLAB_SIZE);
+	mono_gc_wbarrier_set_arrayref(slab.array, addr, nullptr);
+	g_freeHandleSlots.push_back(slot);
+}
+
+MonoObject** GCHandlePool::SlotAddress(uint32_t slot) {
+	ASSERT(slot / SLAB_SIZE < g_numHandleSlabs.load(std::memory_order_acquire));
+	GCHandleSlab_t& slab = g_handleSlabs[slot / SLAB_SIZE];
+	return (MonoObject**)mono_array_addr_with_size(slab.array, sizeof(MonoObject*), slot % SLAB_SIZE);
+}
+
+void GCHandlePool::Reserve(uint32_t count) {
+	std::lock_guard<std::mutex> lock(g_handlePoolLock);
+	while (g_freeHandleSlots.size() < count)
+		AddHandleSlab();
+}
+
+void GCHandlePool::Shutdown() {
+	std::lock_guard<std::mutex> lock(g_handlePoolLock);
+	uint32_t numSlabs = g_numHandleSlabs.load(std::memory_order_relaxed);
+	for (uint32_t i = 0; i < numSlabs; i++) {
+		mono_gchandle_free(g_handleSlabs[i].gcHandle);
+	}
+	g_numHandleSlabs.store(0, std::memory_order_release);
+	g_freeHandleSlots.clear();
+}
+
+//================================================================//
+//
+// Managed Script Context
+//
+//================================================================//
+
+ManagedScriptContext::ManagedScriptContext(const std::string& baseImage, const ManagedScriptSystemSettings_t& settings)
+	: m_baseImage(baseImage), m_exceptionInterval(std::chrono::milliseconds(settings.exceptionAggregationMs)),
+	  m_lastExceptionFlush(std::chrono::steady_clock::now()), m_lazyReflection(settings.lazyReflection),
+	  m_reflectionThreads(settings.reflectionThreads), m_internLimit(settings.internedStringLimit) {
+}
+
+ManagedScriptContext::~ManagedScriptContext() {
+	SetExceptionDelivery(EExceptionDelivery::IMMEDIATE);
+	ClearInternedStrings();
+	for (auto& a : m_loadedAssemblies) {
+		UnregisterScriptImage(a->m_image);
+		if (a->m_image)
+			mono_image_close(a->m_image);
+		if (a->m_assembly)
+			mono_assembly_close(a->m_assembly);
+	}
+}
+
+bool ManagedScriptContext::Init() {
+	// m_domain = mono_domain_create_appdomain("abcd", nullptr);
 	m_domain = g_jitDomain;
 
 	MonoAssembly* ass = mono_domain_assembly_open(m_domain, m_baseImage.c_str());
@@ -680,6 +1363,7 @@ bool ManagedScriptContext::Init() {
 	}
 	ManagedAssembly* newass = new ManagedAssembly(this, m_baseImage, img, ass);
 	m_loadedAssemblies.push_back(newass);
+	m_missingClasses.clear();
 	newass->PopulateReflectionInfo();
 
 	m_initialized = true;
@@ -699,6 +1383,8 @@ bool ManagedScriptContext::LoadAssembly(const char* path) {
 	}
 	ManagedAssembly* newass = new ManagedAssembly(this, path, img, ass);
 	m_loadedAssemblies.push_back(newass);
+	/* The new assembly may provide classes we previously failed to find */
+	m_missingClasses.clear();
 	newass->PopulateReflectionInfo();
 	return true;
 }
@@ -706,6 +1392,11 @@ bool ManagedScriptContext::LoadAssembly(const char* path) {
 bool ManagedScriptContext::UnloadAssembly(const std::string& name) {
 	for (auto it = m_loadedAssemblies.begin(); it != m_loadedAssemblies.end(); ++it) {
 		if ((*it)->m_path == name) {
+			/* Summaries and queued reports reference the assembly */
+			FlushExceptionSummaries();
+			WaitForExceptionQueue();
+			RemoveIndexedClasses(**it);
+			UnregisterScriptImage((*it)->m_image);
 			if ((*it)->m_image)
 				mono_image_close((*it)->m_image);
 			if ((*it)->m_assembly)
@@ -721,14 +1412,30 @@ bool ManagedScriptContext::UnloadAssembly(const std::string& name) {
 /* If you have the assembly name, please use the alternative version of this
  * function */
 ManagedClass* ManagedScriptContext::FindClass(const std::string& ns, const std::string& cls) {
+	const std::string& lookupKey = ClassKey(ns, cls);
+	auto it = m_classIndex.find(lookupKey);
+	if (it != m_classIndex.end())
+		return it->second;
+	if (m_missingClasses.count(lookupKey))
+		return nullptr;
+
+	/* Slow path, the key buffer may be reused while creating the class */
+	std::string key = lookupKey;
+
 	/* Try to find the managed class in each of the assemblies. if found, create
 	 * the managed class and return */
-	/* Also check the hashmap we have setup */
 	for (auto& a : m_loadedAssemblies) {
 		ManagedClass* _cls = nullptr;
-		if (a && (_cls = FindClass(*a, ns, cls)))
+		if (a && (_cls = FindClass(*a, ns, cls))) {
+			m_classIndex.emplace(key, _cls);
 			return _cls;
+		}
 	}
+
+	/* Lookups of arbitrary names shouldn't grow this forever. Forgetting a miss only costs a search */
+	if (m_missingClasses.size() >= MISSING_CLASS_LIMIT)
+		m_missingClasses.clear();
+	m_missingClasses.insert(std::move(key));
 	return nullptr;
 }
 
@@ -744,31 +1451,52 @@ ManagedClass* ManagedScriptContext::FindClass(ManagedAssembly& assembly, const s
 	 * managed class */
 	MonoClass* monoClass = mono_class_from_name(assembly.m_image, ns.c_str(), cls.c_str());
 	if (monoClass) {
-		ManagedClass* _class = new ManagedClass(&assembly, monoClass, ns, cls);
-		assembly.m_classes.insert({ns, _class});
+		ManagedClass* _class = assembly.m_arena.New<ManagedClass>(&assembly, monoClass);
+		assembly.m_classes.insert({_class->m_namespaceName, _class});
 		return _class;
 	}
 
 	return nullptr;
 }
 
-/* Used to locate a class not added by any assemblies explicitly loaded by the
- * user */
-/* These assemblies are usually going to be system assemblies or members of the
- * C# standard library */
-MonoClass* ManagedScriptContext::FindSystemClass(const std::string& ns, const std::string& cls) {
+void ManagedScriptContext::RemoveIndexedClasses(ManagedAssembly& assembly) {
+	for (auto it = m_classIndex.begin(); it != m_classIndex.end();) {
+		if (it->second->m_assembly == &assembly)
+			it = m_classIndex.erase(it);
+		else
+			++it;
+	}
+	std::lock_guard<std::mutex> lock(m_exceptionLock);
+	for (auto it = m_exceptionClasses.begin(); it != m_exceptionClasses.end();) {
+		if (mono_class_get_image(it->first) == assembly.m_image)
+			it = m_exceptionClasses.erase(it);
+		else
+			++it;
+	}
+}
+
+const std::string& ManagedScriptContext::ClassKey(std::string_view ns, std::string_view cls) {
+	/* Per thread so lookups can run on reflection workers. Names can contain dots, but never a
+	 * null character, so keys of different namespace and class pairs can't collide */
+	thread_local std::string key;
+	key.assign(ns);
+	key.push_back('\0');
+	key.append(cls);
+	return key;
+}
+
+/* Searches every assembly mono has loaded for the class. This is slow, use the cache */
+static MonoClass* LookupSystemClass(const char* ns, const char* cls) {
 	struct pvt_t
 	{
-		ManagedScriptContext* _this;
 		const char* ns;
 		const char* cls;
 		bool isdone;
 		MonoClass* result;
 	} pvt;
 
-	pvt.cls = cls.c_str();
-	pvt.ns = ns.c_str();
-	pvt._this = this;
+	pvt.cls = cls;
+	pvt.ns = ns;
 	pvt.result = nullptr;
 	pvt.isdone = false;
 
@@ -796,6 +1524,29 @@ MonoClass* ManagedScriptContext::FindSystemClass(const std::string& ns, const st
 	return pvt.result;
 }
 
+/* Used to locate a class not added by any assemblies explicitly loaded by the
+ * user */
+/* These assemblies are usually going to be system assemblies or members of the
+ * C# standard library */
+MonoClass* ManagedScriptContext::FindSystemClass(const std::string& ns, const std::string& cls) {
+	{
+		std::lock_guard<std::mutex> lock(g_systemClassLock);
+		auto nsIt = g_systemClasses.find(ns);
+		if (nsIt != g_systemClasses.end()) {
+			auto it = nsIt->second.find(cls);
+			if (it != nsIt->second.end())
+				return it->second;
+		}
+	}
+
+	/* Not holding the lock here, the lookup can load assemblies and re-enter the profiler callbacks */
+	MonoClass* result = LookupSystemClass(ns.c_str(), cls.c_str());
+
+	std::lock_guard<std::mutex> lock(g_systemClassLock);
+	g_systemClasses[ns].emplace(cls, result);
+	return result;
+}
+
 ManagedAssembly* ManagedScriptContext::FindAssembly(const std::string& path) {
 	for (auto& a : m_loadedAssemblies) {
 		if (a->m_path == path) {
@@ -809,11 +1560,11 @@ ManagedAssembly* ManagedScriptContext::FindAssembly(const std::string& path) {
 /* WARNING: this will invalidate your handles! */
 void ManagedScriptContext::ClearReflectionInfo() {
 	for (auto& a : m_loadedAssemblies) {
-		for (auto& kvPair : a->m_classes) {
-			delete kvPair.second;
-		}
 		a->m_classes.clear();
+		a->m_arena.Reset();
 	}
+	m_classIndex.clear();
+	m_missingClasses.clear();
 }
 
 void ManagedScriptContext::PopulateReflectionInfo() {
@@ -830,70 +1581,891 @@ bool ManagedScriptContext::ValidateAgainstWhitelist(const std::vector<std::strin
 	return true;
 }
 
-void ManagedScriptContext::ReportException(MonoObject& obj, ManagedAssembly& ass) {
-	auto exc = this->GetExceptionDescriptor(&obj);
+MonoString* ManagedScriptContext::InternString(std::string_view str) {
+	auto it = m_internIndex.find(str);
+	if (it != m_internIndex.end()) {
+		/* Move to the front so it's evicted last */
+		m_internedStrings.splice(m_internedStrings.begin(), m_internedStrings, it->second);
+		return (MonoString*)it->second->ref.Resolve();
+	}
+
+	MonoString* monoStr = mono_string_new_len(m_domain, str.data(), (unsigned)str.size());
+	if (!monoStr || !m_internLimit)
+		return monoStr;
+
+	if (m_internedStrings.size() >= m_internLimit) {
+		auto& oldest = m_internedStrings.back();
+		m_internIndex.erase(oldest.value);
+		oldest.ref.Release();
+		m_internedStrings.pop_back();
+	}
+
+	m_internedStrings.push_front({std::string(str), ObjectRef::Acquire((MonoObject*)monoStr)});
+	m_internIndex.emplace(m_internedStrings.front().value, m_internedStrings.begin());
+	return monoStr;
+}
+
+void ManagedScriptContext::ClearInternedStrings() {
+	m_internIndex.clear();
+	for (auto& interned : m_internedStrings)
+		interned.ref.Release();
+	m_internedStrings.clear();
+}
+
+void ManagedScriptContext::ReportException(MonoObject& obj, ManagedAssembly& ass, MonoMethod* method) {
+	/* Shared by the summary and every callback, so each field is read from managed code at most once */
+	ManagedExceptionDesc desc = DescribeException(&obj);
+	if (m_exceptionInterval.load().count() <= 0) {
+		DeliverException(desc, ass);
+		return;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	MonoClass* cls = mono_object_get_class(&obj);
+	std::unique_lock<std::mutex> lock(m_exceptionLock);
+	auto it = m_exceptionSummaries.find({cls, method});
+	bool inserted = false;
+
+	/* First of its kind in this interval. Report it right away so it isn't delayed. The descriptor
+	 * is only read when someone consumes summaries, and without the lock held since it calls into
+	 * managed code */
+	if (it == m_exceptionSummaries.end()) {
+		ManagedException_t first;
+		if (!m_summaryCallbacks.empty()) {
+			lock.unlock();
+			first = desc.Materialize();
+			lock.lock();
+		}
+
+		auto result = m_exceptionSummaries.try_emplace({cls, method});
+		it = result.first;
+		inserted = result.second;
+		if (inserted) {
+			it->second.assembly = &ass;
+			it->second.klass = cls;
+			it->second.method = method;
+			it->second.firstSeen = now;
+			it->second.first = std::move(first);
+		}
+	}
+	it->second.lastSeen = now;
+	it->second.count++;
+
+	bool flush = now - m_lastExceptionFlush >= m_exceptionInterval.load();
+	lock.unlock();
+
+	if (inserted)
+		DeliverException(desc, ass);
+	if (flush)
+		FlushExceptionSummaries();
+}
+
+void ManagedScriptContext::SetExceptionAggregation(std::chrono::milliseconds interval) {
+	FlushExceptionSummaries();
+	m_exceptionInterval.store(interval);
+}
+
+void ManagedScriptContext::FlushDueExceptionSummaries() {
+	std::chrono::milliseconds interval = m_exceptionInterval.load();
+	if (interval.count() <= 0)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(m_exceptionLock);
+		if (m_exceptionSummaries.empty() || std::chrono::steady_clock::now() - m_lastExceptionFlush < interval)
+			return;
+	}
+	FlushExceptionSummaries();
+}
+
+void ManagedScriptContext::FlushExceptionSummaries() {
+	/* Callbacks run without the lock so they may report exceptions themselves */
+	std::vector<ManagedExceptionSummary_t> flushed;
+	{
+		std::lock_guard<std::mutex> lock(m_exceptionLock);
+		m_lastExceptionFlush = std::chrono::steady_clock::now();
+		if (m_exceptionSummaries.empty())
+			return;
+
+		flushed.reserve(m_exceptionSummaries.size());
+		for (auto& kv : m_exceptionSummaries)
+			flushed.push_back(std::move(kv.second));
+		m_exceptionSummaries.clear();
+	}
+
+	for (auto& c : m_summaryCallbacks) {
+		c(this, flushed);
+	}
+}
+
+void ManagedScriptContext::DeliverException(const ManagedExceptionDesc& desc, ManagedAssembly& ass) {
+	for (auto& c : m_lazyCallbacks) {
+		c(this, &ass, desc);
+	}
+
+	if (m_callbacks.empty())
+		return;
+
+	auto exc = desc.Materialize();
+	EExceptionDelivery mode = m_exceptionDelivery.load(std::memory_order_acquire);
+	if (mode != EExceptionDelivery::IMMEDIATE) {
+		/* Counted first so the consumer never sees the count drop below zero */
+		m_queuedExceptions.fetch_add(1, std::memory_order_release);
+		m_exceptionQueue.Push({&ass, std::move(exc)});
+		if (mode == EExceptionDelivery::WORKER)
+			m_exceptionWorkerWake.notify_one();
+		return;
+	}
 
 	for (auto& c : m_callbacks) {
-		c(this, &ass, &obj, exc);
+		c(this, &ass, desc.RawException(), exc);
+	}
+}
+
+size_t ManagedScriptContext::DrainExceptionQueue() {
+	/* The queue only supports one consumer at a time. Recursive since a callback may unload an
+	 * assembly, which drains again on the same thread */
+	std::lock_guard<std::recursive_mutex> consumer(m_exceptionConsumerLock);
+	size_t delivered = 0;
+	QueuedException_t queued;
+	while (m_exceptionQueue.Pop(queued)) {
+		for (auto& c : m_callbacks) {
+			c(this, queued.assembly, nullptr, queued.exc);
+		}
+		if (m_queuedExceptions.fetch_sub(1, std::memory_order_release) == 1) {
+			/* Taking the lock orders this with a waiter that just checked the count */
+			std::lock_guard<std::mutex> lock(m_exceptionWorkerLock);
+			m_exceptionQueueDrained.notify_all();
+		}
+		delivered++;
+	}
+	return delivered;
+}
+
+void ManagedScriptContext::WaitForExceptionQueue() {
+	/* A callback on the worker may get here too, e.g. by unloading an assembly. It can't wait on itself,
+	 * so it delivers the rest of the queue inline */
+	if (m_exceptionDelivery.load() != EExceptionDelivery::WORKER ||
+		std::this_thread::get_id() == m_exceptionWorker.get_id()) {
+		DrainExceptionQueue();
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(m_exceptionWorkerLock);
+	m_exceptionWorkerWake.notify_one();
+	m_exceptionQueueDrained.wait(lock, [this]() { return m_queuedExceptions.load(std::memory_order_acquire) == 0; });
+}
+
+size_t ManagedScriptContext::PumpExceptions() {
+	/* The worker is the only consumer in WORKER mode, and flushes summaries itself */
+	if (m_exceptionDelivery.load() == EExceptionDelivery::WORKER)
+		return 0;
+	size_t delivered = DrainExceptionQueue();
+	FlushDueExceptionSummaries();
+	return delivered;
+}
+
+void ManagedScriptContext::SetExceptionDelivery(EExceptionDelivery mode) {
+	if (mode == m_exceptionDelivery.load())
+		return;
+
+	/* The worker would have to join itself */
+	ASSERT(std::this_thread::get_id() != m_exceptionWorker.get_id());
+
+	if (m_exceptionWorker.joinable()) {
+		m_exceptionWorkerStop.store(true);
+		m_exceptionWorkerWake.notify_one();
+		m_exceptionWorker.join();
+		m_exceptionWorkerStop.store(false);
+	}
+
+	/* Anything still queued is delivered before the mode changes. Reports that read the old
+	 * mode while it changed are delivered by a second drain */
+	DrainExceptionQueue();
+	m_exceptionDelivery.store(mode, std::memory_order_release);
+	if (mode == EExceptionDelivery::IMMEDIATE)
+		DrainExceptionQueue();
+
+	if (mode == EExceptionDelivery::WORKER) {
+		m_exceptionWorker = std::thread([this]() {
+			while (!m_exceptionWorkerStop.load()) {
+				DrainExceptionQueue();
+				/* Delivers the final counts of a burst even if nothing is thrown after it */
+				FlushDueExceptionSummaries();
+				/* Producers notify without the lock, so a wakeup can be missed. The timeout
+				 * bounds how long a report can sit in the queue when that happens */
+				std::unique_lock<std::mutex> lock(m_exceptionWorkerLock);
+				m_exceptionWorkerWake.wait_for(lock, std::chrono::milliseconds(50), [this]() {
+					return m_exceptionWorkerStop.load() || m_queuedExceptions.load(std::memory_order_acquire) > 0;
+				});
+			}
+		});
 	}
 }
 
 ManagedException_t ManagedScriptContext::GetExceptionDescriptor(MonoObject* exception) {
-	ManagedException_t exc;
+	return DescribeException(exception).Materialize();
+}
+
+ManagedExceptionDesc ManagedScriptContext::DescribeException(MonoObject* exception) {
+	return ManagedExceptionDesc(exception, GetExceptionClass(mono_object_get_class(exception)));
+}
+
+const ManagedExceptionClass_t* ManagedScriptContext::GetExceptionClass(MonoClass* cls) {
+	{
+		std::lock_guard<std::mutex> lock(m_exceptionLock);
+		auto it = m_exceptionClasses.find(cls);
+		if (it != m_exceptionClasses.end())
+			return &it->second;
+	}
+
+	ManagedExceptionClass_t info = {};
 
 	/* Make sure that the baseclass of the exception is System.Exception. If
 	 * not, we've got some weird object that we shouldn't have */
-	MonoClass* cls = mono_object_get_class(exception);
 	MonoClass* excClass = FindSystemClass("System", "Exception");
-	if (!mono_object_isinst(exception, excClass)) {
-		return exc;
+	info.isException = excClass && mono_class_is_subclass_of(cls, excClass, false);
+
+	if (info.isException) {
+		auto getter = [cls](const char* name) -> MonoMethod* {
+			MonoProperty* prop = mono_class_get_property_from_name(cls, name);
+			return prop ? mono_property_get_get_method(prop) : nullptr;
+		};
+		info.messageGetter = getter("Message");
+		info.sourceGetter = getter("Source");
+		info.stackTraceGetter = getter("StackTrace");
 	}
 
-	/* Obtain the properties by iterating through the class's props */
-	MonoProperty* propMsg = mono_class_get_property_from_name(cls, "Message");
-	MonoProperty* propSrc = mono_class_get_property_from_name(cls, "Source");
-	MonoProperty* propST = mono_class_get_property_from_name(cls, "StackTrace");
+	/* Another thread may have gotten here first, in which case its entry is kept */
+	std::lock_guard<std::mutex> lock(m_exceptionLock);
+	return &m_exceptionClasses.emplace(cls, info).first->second;
+}
 
-	/* Obtain the properties */
-	/* This is a big weird and unoptimized because mono I guess */
-	MonoObject* msg = nullptr;
-	MonoObject* src = nullptr;
-	MonoObject* stack = nullptr;
-	MonoObject* propexcept = nullptr;
-	msg = mono_property_get_value(propMsg, exception, nullptr, &propexcept);
-	src = mono_property_get_value(propSrc, exception, nullptr, &propexcept);
-	stack = mono_property_get_value(propST, exception, nullptr, &propexcept);
+//================================================================//
+//
+// Profiling Counters
+//
+//================================================================//
 
-	if (msg) {
-		char* buf = mono_string_to_utf8(mono_object_to_string(msg, nullptr));
-		exc.message = (const char*)buf;
-		mono_free(buf);
+/* Each thread counts into its own frames, so there's no contention and no locked instructions
+ * on the hot path. Frames are cache line aligned to keep threads from sharing lines */
+struct alignas(64) ProfilingShard_t
+{
+	std::atomic<size_t> bytesMoved{0};
+	std::atomic<size_t> totalMoves{0};
+	std::atomic<size_t> bytesAlloc{0};
+	std::atomic<size_t> totalAllocs{0};
+	std::atomic<size_t> totalContextUnloads{0};
+	std::atomic<size_t> totalContextLoads{0};
+
+	ManagedProfilingData_t Snapshot() const {
+		ManagedProfilingData_t data;
+		data.bytesMoved = bytesMoved.load(std::memory_order_relaxed);
+		data.totalMoves = totalMoves.load(std::memory_order_relaxed);
+		data.bytesAlloc = bytesAlloc.load(std::memory_order_relaxed);
+		data.totalAllocs = totalAllocs.load(std::memory_order_relaxed);
+		data.totalContextUnloads = totalContextUnloads.load(std::memory_order_relaxed);
+		data.totalContextLoads = totalContextLoads.load(std::memory_order_relaxed);
+		return data;
 	}
-	if (src) {
-		char* buf = mono_string_to_utf8(mono_object_to_string(src, nullptr));
-		exc.source = (const char*)buf;
-		mono_free(buf);
+
+	void Add(const ManagedProfilingData_t& data);
+};
+
+/* Only the owning thread writes a shard, so a plain load and store is enough. Readers on
+ * other threads see a consistent value for each counter */
+static inline void BumpCounter(std::atomic<size_t>& counter, size_t amount) {
+	counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+static void AddProfilingData(ManagedProfilingData_t& to, const ManagedProfilingData_t& from) {
+	to.bytesMoved += from.bytesMoved;
+	to.totalMoves += from.totalMoves;
+	to.bytesAlloc += from.bytesAlloc;
+	to.totalAllocs += from.totalAllocs;
+	to.totalContextUnloads += from.totalContextUnloads;
+	to.totalContextLoads += from.totalContextLoads;
+}
+
+void ProfilingShard_t::Add(const ManagedProfilingData_t& data) {
+	BumpCounter(bytesMoved, data.bytesMoved);
+	BumpCounter(totalMoves, data.totalMoves);
+	BumpCounter(bytesAlloc, data.bytesAlloc);
+	BumpCounter(totalAllocs, data.totalAllocs);
+	BumpCounter(totalContextUnloads, data.totalContextUnloads);
+	BumpCounter(totalContextLoads, data.totalContextLoads);
+}
+
+struct ThreadProfilingState_t;
+
+/* Allocations attributed to a class or method. Doubles since sampled allocations are weighted */
+struct AllocationStat_t
+{
+	double count;
+	double bytes;
+};
+using AllocationClassMap = std::unordered_map<MonoClass*, AllocationStat_t>;
+using AllocationMethodMap = std::unordered_map<MonoMethod*, AllocationStat_t>;
+
+/* Live threads, and the totals of threads that have exited. Guarded by g_profilingThreadLock */
+static std::mutex g_profilingThreadLock;
+static std::vector<ThreadProfilingState_t*> g_profilingThreads;
+static ManagedProfilingData_t g_retiredProfilingData;
+static AllocationClassMap g_retiredAllocClasses;
+static AllocationMethodMap g_retiredAllocMethods;
+
+template <class MapT> static void MergeAllocationStats(MapT& to, const MapT& from) {
+	for (auto& kv : from) {
+		auto& stat = to[kv.first];
+		stat.count += kv.second.count;
+		stat.bytes += kv.second.bytes;
 	}
-	if (stack) {
-		char* buf = mono_string_to_utf8(mono_object_to_string(stack, nullptr));
-		exc.stackTrace = (const char*)buf;
-		mono_free(buf);
+}
+
+struct ThreadProfilingState_t
+{
+	std::mutex lock; // Guards frames and allocation stats against readers, counters don't take it
+	std::vector<std::unique_ptr<ProfilingShard_t>> frames;
+	ProfilingShard_t* current;
+
+	AllocationClassMap allocClasses;
+	AllocationMethodMap allocMethods;
+	int64_t bytesUntilSample = 0;
+	uint64_t rng;
+
+	/* Size of the last allocated class, 0 if its instances vary in size */
+	MonoClass* lastAllocClass = nullptr;
+	size_t lastAllocSize = 0;
+
+	ThreadProfilingState_t() {
+		rng = (uint64_t)(uintptr_t)this | 1;
+		frames.emplace_back(new ProfilingShard_t());
+		current = frames.back().get();
+		std::lock_guard<std::mutex> threadLock(g_profilingThreadLock);
+		g_profilingThreads.push_back(this);
 	}
 
-	exc.klass = mono_class_get_name(cls);
-	exc.ns = mono_class_get_namespace(cls);
+	~ThreadProfilingState_t() {
+		std::lock_guard<std::mutex> threadLock(g_profilingThreadLock);
+		for (auto& frame : frames)
+			AddProfilingData(g_retiredProfilingData, frame->Snapshot());
+		MergeAllocationStats(g_retiredAllocClasses, allocClasses);
+		MergeAllocationStats(g_retiredAllocMethods, allocMethods);
+		g_profilingThreads.erase(std::find(g_profilingThreads.begin(), g_profilingThreads.end(), this));
+	}
+};
 
-	MonoObject* pexc = nullptr;
-	char* str = mono_string_to_utf8(mono_object_to_string(exception, &pexc));
+/* Plain pointers, so there's no TLS destructor that profiler callbacks late in thread exit could
+ * run after. The state is retired by Profiler_ThreadExited instead, after which the thread
+ * records nothing until it attaches to the runtime again */
+static thread_local ThreadProfilingState_t* t_profilingState;
+static thread_local bool t_profilingRetired;
+
+/* Null while the calling thread is retired */
+static ThreadProfilingState_t* ProfilingState() {
+	if (!t_profilingState && !t_profilingRetired)
+		t_profilingState = new ThreadProfilingState_t();
+	return t_profilingState;
+}
+
+//================================================================//
+//
+// Allocation Attribution
+//
+//================================================================//
 
-	if (!pexc && str) {
-		exc.string_rep = (const char*)str;
+static bool g_allocationEvents; // Set when allocation events were enabled before the runtime started
+static std::atomic<bool> g_profileAllocations;
+static std::atomic<uint32_t> g_allocSampleBytes;
+
+static size_t AllocationSize(ThreadProfilingState_t& state, MonoObject* obj, MonoClass* cls) {
+	/* Arrays and strings vary in size, everything else is the class's instance size. Allocations
+	 * tend to come in runs of the same class, so remembering the last one skips most lookups */
+	if (cls != state.lastAllocClass) {
+		state.lastAllocClass = cls;
+		bool variable = mono_class_get_rank(cls) || cls == mono_get_string_class();
+		state.lastAllocSize = variable ? 0 : mono_class_instance_size(cls);
 	}
+	return state.lastAllocSize ? state.lastAllocSize : mono_object_get_size(obj);
+}
 
-	if (str)
-		mono_free(str);
+/* Exponentially distributed gap between samples, so sample points form a Poisson process
+ * over allocated bytes */
+static int64_t NextSampleInterval(ThreadProfilingState_t& state, uint32_t mean) {
+	state.rng ^= state.rng << 13;
+	state.rng ^= state.rng >> 7;
+	state.rng ^= state.rng << 17;
+	double u = ((state.rng >> 11) + 1) * (1.0 / 9007199254740992.0); // (0, 1]
+	return (int64_t)(-std::log(u) * mean) + 1;
+}
 
-	return exc;
+static mono_bool FindAllocatingMethod(MonoMethod* method, int32_t nativeOffset, int32_t ilOffset, mono_bool managed,
+									  void* data) {
+	if (!managed)
+		return false;
+	*static_cast<MonoMethod**>(data) = method;
+	return true;
+}
+
+static void RecordAllocation(ThreadProfilingState_t& state, MonoClass* cls, size_t size) {
+	uint32_t sampleBytes = g_allocSampleBytes.load(std::memory_order_relaxed);
+	double weight = 1.0;
+	if (sampleBytes) {
+		state.bytesUntilSample -= (int64_t)size;
+		if (state.bytesUntilSample > 0)
+			return;
+		state.bytesUntilSample = NextSampleInterval(state, sampleBytes);
+		/* Inverse of the chance that an allocation of this size is sampled */
+		weight = 1.0 / (1.0 - std::exp(-(double)size / sampleBytes));
+	}
+
+	MonoMethod* method = nullptr;
+	mono_stack_walk_no_il(FindAllocatingMethod, &method);
+
+	std::lock_guard<std::mutex> lock(state.lock);
+	auto& byClass = state.allocClasses[cls];
+	byClass.count += weight;
+	byClass.bytes += weight * size;
+	auto& byMethod = state.allocMethods[method];
+	byMethod.count += weight;
+	byMethod.bytes += weight * size;
+}
+
+/* Drops stats for classes and methods of an image that's going away */
+static void PurgeAllocationStats(MonoImage* img) {
+	auto purge = [img](AllocationClassMap& classes, AllocationMethodMap& methods) {
+		for (auto it = classes.begin(); it != classes.end();) {
+			if (mono_class_get_image(it->first) == img)
+				it = classes.erase(it);
+			else
+				++it;
+		}
+		for (auto it = methods.begin(); it != methods.end();) {
+			if (it->first && mono_class_get_image(mono_method_get_class(it->first)) == img)
+				it = methods.erase(it);
+			else
+				++it;
+		}
+	};
+
+	std::lock_guard<std::mutex> threadLock(g_profilingThreadLock);
+	purge(g_retiredAllocClasses, g_retiredAllocMethods);
+	for (auto* state : g_profilingThreads) {
+		std::lock_guard<std::mutex> stateLock(state->lock);
+		purge(state->allocClasses, state->allocMethods);
+	}
+}
+
+template <class MapT>
+static std::vector<ManagedAllocationStats_t> CollectAllocationStats(MapT ThreadProfilingState_t::*member,
+																	const MapT& retired, size_t topN) {
+	MapT merged;
+	{
+		std::lock_guard<std::mutex> threadLock(g_profilingThreadLock);
+		merged = retired;
+		for (auto* state : g_profilingThreads) {
+			std::lock_guard<std::mutex> stateLock(state->lock);
+			MergeAllocationStats(merged, state->*member);
+		}
+	}
+
+	std::vector<std::pair<typename MapT::key_type, AllocationStat_t>> sorted(merged.begin(), merged.end());
+	std::sort(sorted.begin(), sorted.end(),
+			  [](const auto& a, const auto& b) { return a.second.bytes > b.second.bytes; });
+	if (topN && sorted.size() > topN)
+		sorted.resize(topN);
+
+	std::vector<ManagedAllocationStats_t> result;
+	result.reserve(sorted.size());
+	for (auto& kv : sorted) {
+		ManagedAllocationStats_t stats = {};
+		stats.count = (uint64_t)std::llround(kv.second.count);
+		stats.bytes = (uint64_t)std::llround(kv.second.bytes);
+		if constexpr (std::is_same_v<typename MapT::key_type, MonoClass*>) {
+			stats.klass = kv.first;
+			const char* ns = mono_class_get_namespace(kv.first);
+			const char* name = mono_class_get_name(kv.first);
+			stats.name = ns && *ns ? std::string(ns) + "." + name : name;
+		} else {
+			stats.method = kv.first;
+			char* name = kv.first ? mono_method_full_name(kv.first, false) : nullptr;
+			stats.name = name ? name : "[native]";
+			if (name)
+				mono_free(name);
+		}
+		result.push_back(std::move(stats));
+	}
+	return result;
+}
+
+std::vector<ManagedAllocationStats_t> ManagedScriptSystem::GetAllocationsByClass(size_t topN) {
+	return CollectAllocationStats(&ThreadProfilingState_t::allocClasses, g_retiredAllocClasses, topN);
+}
+
+std::vector<ManagedAllocationStats_t> ManagedScriptSystem::GetAllocationsByMethod(size_t topN) {
+	return CollectAllocationStats(&ThreadProfilingState_t::allocMethods, g_retiredAllocMethods, topN);
+}
+
+void ManagedScriptSystem::ResetAllocationStats() {
+	std::lock_guard<std::mutex> threadLock(g_profilingThreadLock);
+	g_retiredAllocClasses.clear();
+	g_retiredAllocMethods.clear();
+	for (auto* state : g_profilingThreads) {
+		std::lock_guard<std::mutex> stateLock(state->lock);
+		state->allocClasses.clear();
+		state->allocMethods.clear();
+	}
+}
+
+//================================================================//
+//
+// Sampling Profiler
+//
+//================================================================//
+
+/* Samples are taken from a signal handler, so they're written into a preallocated ring without
+ * locks or allocation. Only raw IPs are recorded; symbolizing and aggregating happens later in
+ * CollectSamples */
+static constexpr uint32_t SAMPLE_MAX_FRAMES = 64;
+static constexpr uint64_t SAMPLE_RING_SIZE = 8192;
+
+struct RawSample_t
+{
+	std::atomic<bool> ready;
+	uint32_t depth;
+	const void* frames[SAMPLE_MAX_FRAMES]; // Innermost first
+};
+
+static RawSample_t* g_sampleRing;
+static std::atomic<uint64_t> g_sampleWrite;
+static std::atomic<uint64_t> g_sampleRead;
+static std::atomic<uint64_t> g_samplesDropped;
+
+/* Aggregated samples, guarded by g_sampleLock */
+struct MethodSampleCount_t
+{
+	uint64_t self;
+	uint64_t total;
+};
+static std::mutex g_sampleLock;
+static std::unordered_map<MonoMethod*, MethodSampleCount_t> g_methodSamples;
+static std::map<std::vector<MonoMethod*>, uint64_t> g_foldedStacks; // Outermost first
+static std::unordered_map<MonoMethod*, std::string> g_sampleMethodNames;
+
+static mono_bool SampleWalkFrame(MonoMethod* method, MonoDomain* domain, void* base, int offset, void* data) {
+	RawSample_t* sample = static_cast<RawSample_t*>(data);
+	sample->frames[sample->depth++] = static_cast<const char*>(base) + offset;
+	return sample->depth >= SAMPLE_MAX_FRAMES;
+}
+
+static void Profiler_SampleHit(MonoProfiler* prof, const mono_byte* ip, const void* context) {
+	if (!g_sampleRing)
+		return;
+
+	uint64_t w = g_sampleWrite.load(std::memory_order_relaxed);
+	do {
+		if (w - g_sampleRead.load(std::memory_order_acquire) >= SAMPLE_RING_SIZE) {
+			g_samplesDropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	} while (!g_sampleWrite.compare_exchange_weak(w, w + 1, std::memory_order_acq_rel));
+
+	RawSample_t& sample = g_sampleRing[w % SAMPLE_RING_SIZE];
+	sample.depth = 0;
+	mono_stack_walk_async_safe(SampleWalkFrame, const_cast<void*>(context), &sample);
+	if (!sample.depth)
+		sample.frames[sample.depth++] = ip;
+	sample.ready.store(true, std::memory_order_release);
+}
+
+static const std::string& SampleMethodName(MonoMethod* method) {
+	auto it = g_sampleMethodNames.find(method);
+	if (it != g_sampleMethodNames.end())
+		return it->second;
+
+	char* name = mono_method_full_name(method, false);
+	auto& result = g_sampleMethodNames[method];
+	result = name ? name : "[unknown]";
+	if (name)
+		mono_free(name);
+	return result;
+}
+
+void ManagedScriptSystem::CollectSamples() {
+	if (!g_sampleRing)
+		return;
+
+	std::lock_guard<std::mutex> lock(g_sampleLock);
+	std::vector<MonoMethod*> stack;
+	uint64_t read = g_sampleRead.load(std::memory_order_relaxed);
+	const uint64_t write = g_sampleWrite.load(std::memory_order_acquire);
+	for (; read < write; read++) {
+		RawSample_t& sample = g_sampleRing[read % SAMPLE_RING_SIZE];
+		/* Still being written */
+		if (!sample.ready.load(std::memory_order_acquire))
+			break;
+
+		/* Native frames and trampolines have no jit info and are skipped */
+		stack.clear();
+		for (uint32_t i = sample.depth; i-- > 0;) {
+			MonoJitInfo* ji = mono_jit_info_table_find(g_jitDomain, const_cast<void*>(sample.frames[i]));
+			MonoMethod* method = ji ? mono_jit_info_get_method(ji) : nullptr;
+			if (method)
+				stack.push_back(method);
+		}
+
+		sample.ready.store(false, std::memory_order_relaxed);
+		g_sampleRead.store(read + 1, std::memory_order_release);
+
+		if (stack.empty())
+			continue;
+
+		g_methodSamples[stack.back()].self++;
+		for (size_t i = 0; i < stack.size(); i++) {
+			/* Recursive methods only count once per sample */
+			if (std::find(stack.begin(), stack.begin() + i, stack[i]) == stack.begin() + i)
+				g_methodSamples[stack[i]].total++;
+		}
+		g_foldedStacks[stack]++;
+	}
+}
+
+std::vector<ManagedMethodSamples_t> ManagedScriptSystem::GetMethodSamples() {
+	CollectSamples();
+
+	std::lock_guard<std::mutex> lock(g_sampleLock);
+	std::vector<ManagedMethodSamples_t> result;
+	result.reserve(g_methodSamples.size());
+	for (auto& kv : g_methodSamples)
+		result.push_back({kv.first, SampleMethodName(kv.first), kv.second.self, kv.second.total});
+
+	std::sort(result.begin(), result.end(), [](const ManagedMethodSamples_t& a, const ManagedMethodSamples_t& b) {
+		return a.selfSamples > b.selfSamples;
+	});
+	return result;
+}
+
+std::string ManagedScriptSystem::GetFoldedStacks() {
+	CollectSamples();
+
+	std::lock_guard<std::mutex> lock(g_sampleLock);
+	std::string result;
+	for (auto& kv : g_foldedStacks) {
+		for (size_t i = 0; i < kv.first.size(); i++) {
+			if (i)
+				result += ';';
+			result += SampleMethodName(kv.first[i]);
+		}
+		result += ' ';
+		result += std::to_string(kv.second);
+		result += '\n';
+	}
+	return result;
+}
+
+uint64_t ManagedScriptSystem::DroppedSamples() const {
+	return g_samplesDropped.load(std::memory_order_relaxed);
+}
+
+void ManagedScriptSystem::ResetSamples() {
+	CollectSamples();
+
+	std::lock_guard<std::mutex> lock(g_sampleLock);
+	g_methodSamples.clear();
+	g_foldedStacks.clear();
+	g_sampleMethodNames.clear();
+	g_samplesDropped.store(0, std::memory_order_relaxed);
+}
+
+//================================================================//
+//
+// Call Instrumentation
+//
+//================================================================//
+
+/* Enter and leave events are appended to a buffer owned by the calling thread, which is
+ * published as a block once it fills up or the thread returns from its outermost script
+ * call. Blocks are turned into per method times by GetMethodTimings, or by the publishing
+ * thread once enough of them are queued, so they don't pile up when nobody asks for times */
+static constexpr size_t CALL_BLOCK_SIZE = 4096;
+static constexpr size_t CALL_BLOCK_MIN_PUBLISH = 256;
+static constexpr size_t CALL_BLOCK_PROCESS_THRESHOLD = 64;
+
+static std::atomic<bool> g_instrumentCalls;
+static std::atomic<uint32_t> g_nextCallThread;
+
+struct CallEvent_t
+{
+	MonoMethod* method;
+	uint64_t time : 63;
+	uint64_t leave : 1;
+};
+
+struct CallBlock_t
+{
+	uint32_t thread;
+	std::vector<CallEvent_t> events;
+};
+
+static MpscQueue<CallBlock_t> g_callBlocks;
+static std::atomic<size_t> g_queuedCallBlocks;
+static std::mutex g_callTimingLock;
+
+static void ProcessCallBlocks();
+
+struct ThreadCallBuffer_t
+{
+	uint32_t thread = g_nextCallThread.fetch_add(1);
+	int depth = 0;
+	std::vector<CallEvent_t> events;
+
+	void Publish() {
+		if (events.empty())
+			return;
+		/* Counted first so the consumer never sees the count drop below zero */
+		size_t queued = g_queuedCallBlocks.fetch_add(1, std::memory_order_relaxed) + 1;
+		g_callBlocks.Push({thread, std::move(events)});
+		events = {};
+		events.reserve(CALL_BLOCK_SIZE);
+
+		/* Whoever is processing already will get to this block too */
+		if (queued >= CALL_BLOCK_PROCESS_THRESHOLD && g_callTimingLock.try_lock()) {
+			ProcessCallBlocks();
+			g_callTimingLock.unlock();
+		}
+	}
+
+	~ThreadCallBuffer_t() {
+		Publish();
+	}
+};
+
+/* Retired along with t_profilingState */
+static thread_local ThreadCallBuffer_t* t_callBuffer;
+
+/* Aggregated times and the consumer side of g_callBlocks, guarded by g_callTimingLock */
+struct CallFrame_t
+{
+	MonoMethod* method;
+	uint64_t enter;
+	uint64_t children;
+};
+struct MethodTiming_t
+{
+	uint64_t calls;
+	uint64_t inclusive;
+	uint64_t exclusive;
+};
+static std::unordered_map<MonoMethod*, MethodTiming_t> g_methodTimings;
+static std::unordered_map<uint32_t, std::vector<CallFrame_t>> g_callStacks; // Open calls of each thread
+
+static inline uint64_t CallTimestamp() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			   std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+
+static MonoProfilerCallInstrumentationFlags Profiler_CallFilter(MonoProfiler* prof, MonoMethod* method) {
+	if (!g_instrumentCalls.load(std::memory_order_relaxed))
+		return MONO_PROFILER_CALL_INSTRUMENTATION_NONE;
+
+	std::lock_guard<std::mutex> lock(g_scriptImageLock);
+	if (!g_scriptImages.count(mono_class_get_image(mono_method_get_class(method))))
+		return MONO_PROFILER_CALL_INSTRUMENTATION_NONE;
+	return (MonoProfilerCallInstrumentationFlags)(MONO_PROFILER_CALL_INSTRUMENTATION_ENTER |
+												  MONO_PROFILER_CALL_INSTRUMENTATION_LEAVE |
+												  MONO_PROFILER_CALL_INSTRUMENTATION_EXCEPTION_LEAVE);
+}
+
+static void Profiler_MethodEnter(MonoProfiler* prof, MonoMethod* method, MonoProfilerCallContext* context) {
+	/* Methods stay instrumented after it's turned off, they just stop recording */
+	if (!g_instrumentCalls.load(std::memory_order_relaxed) || t_profilingRetired)
+		return;
+	if (!t_callBuffer)
+		t_callBuffer = new ThreadCallBuffer_t();
+	ThreadCallBuffer_t& buffer = *t_callBuffer;
+	buffer.events.push_back({method, CallTimestamp(), 0});
+	buffer.depth++;
+	if (buffer.events.size() >= CALL_BLOCK_SIZE)
+		buffer.Publish();
+}
+
+static void Profiler_MethodLeave(MonoProfiler* prof, MonoMethod* method, MonoProfilerCallContext* context) {
+	if (!t_callBuffer || !t_callBuffer->depth)
+		return;
+	ThreadCallBuffer_t& buffer = *t_callBuffer;
+	buffer.events.push_back({method, CallTimestamp(), 1});
+	buffer.depth--;
+	if (buffer.events.size() >= CALL_BLOCK_SIZE || (!buffer.depth && buffer.events.size() >= CALL_BLOCK_MIN_PUBLISH))
+		buffer.Publish();
+}
+
+static void Profiler_MethodExceptionLeave(MonoProfiler* prof, MonoMethod* method, MonoObject* exc) {
+	Profiler_MethodLeave(prof, method, nullptr);
+}
+
+static void ProcessCallBlocks() {
+	CallBlock_t block;
+	while (g_callBlocks.Pop(block)) {
+		g_queuedCallBlocks.fetch_sub(1, std::memory_order_relaxed);
+		auto& stack = g_callStacks[block.thread];
+		for (auto& ev : block.events) {
+			if (!ev.leave) {
+				stack.push_back({ev.method, ev.time, 0});
+				continue;
+			}
+
+			/* Frames above the matching one left without an event, drop them */
+			while (!stack.empty() && stack.back().method != ev.method)
+				stack.pop_back();
+			if (stack.empty())
+				continue;
+
+			CallFrame_t frame = stack.back();
+			stack.pop_back();
+			uint64_t inclusive = ev.time - frame.enter;
+			MethodTiming_t& timing = g_methodTimings[frame.method];
+			timing.calls++;
+			timing.inclusive += inclusive;
+			timing.exclusive += inclusive > frame.children ? inclusive - frame.children : 0;
+			if (!stack.empty())
+				stack.back().children += inclusive;
+		}
+	}
+}
+
+void ManagedScriptSystem::FlushCallEvents() {
+	/* Calls still open are carried over by ProcessCallBlocks, so this is fine at any depth */
+	if (t_callBuffer)
+		t_callBuffer->Publish();
+}
+
+std::vector<ManagedMethodTiming_t> ManagedScriptSystem::GetMethodTimings() {
+	/* Publishing may process blocks itself, so it happens before the lock is taken */
+	FlushCallEvents();
+	std::lock_guard<std::mutex> lock(g_callTimingLock);
+	ProcessCallBlocks();
+
+	std::vector<ManagedMethodTiming_t> result;
+	result.reserve(g_methodTimings.size());
+	for (auto& kv : g_methodTimings) {
+		char* name = mono_method_full_name(kv.first, false);
+		result.push_back({kv.first, name ? name : "[unknown]", kv.second.calls, kv.second.inclusive,
+						  kv.second.exclusive});
+		if (name)
+			mono_free(name);
+	}
+
+	std::sort(result.begin(), result.end(), [](const ManagedMethodTiming_t& a, const ManagedMethodTiming_t& b) {
+		return a.exclusiveNs > b.exclusiveNs;
+	});
+	return result;
+}
+
+void ManagedScriptSystem::ResetMethodTimings() {
+	FlushCallEvents();
+	std::lock_guard<std::mutex> lock(g_callTimingLock);
+	ProcessCallBlocks();
+	g_methodTimings.clear();
 }
 
 //================================================================//
@@ -903,7 +2475,7 @@ ManagedException_t ManagedScriptContext::GetExceptionDescriptor(MonoObject* exce
 //================================================================//
 
 ManagedScriptSystem::ManagedScriptSystem(ManagedScriptSystemSettings_t settings)
-	: m_settings(settings), m_curFrame(nullptr) {
+	: m_settings(settings), m_profilingSettings() {
 	/* Basically just a guard to ensure we dont have multiple per process */
 	static bool g_managedScriptSystemExists = false;
 	if (g_managedScriptSystemExists) {
@@ -919,9 +2491,6 @@ ManagedScriptSystem::ManagedScriptSystem(ManagedScriptSystemSettings_t settings)
 	else
 		mono_config_parse_memory(settings.configData);
 
-	/* Push a root profiling context */
-	this->PushProfilingContext();
-
 	/* Create and register the new profiler */
 	g_monoProfiler.handle = mono_profiler_create(&g_monoProfiler);
 	g_monoProfiler.scriptsys = this;
@@ -933,6 +2502,28 @@ ManagedScriptSystem::ManagedScriptSystem(ManagedScriptSystemSettings_t settings)
 	mono_profiler_set_gc_resize_callback(g_monoProfiler.handle, Profiler_GCResize);
 	mono_profiler_set_context_loaded_callback(g_monoProfiler.handle, Profiler_ContextLoaded);
 	mono_profiler_set_context_unloaded_callback(g_monoProfiler.handle, Profiler_ContextUnloaded);
+	mono_profiler_set_assembly_loaded_callback(g_monoProfiler.handle, Profiler_AssemblyLoaded);
+	mono_profiler_set_assembly_unloading_callback(g_monoProfiler.handle, Profiler_AssemblyUnloading);
+	mono_profiler_set_thread_started_callback(g_monoProfiler.handle, Profiler_ThreadStarted);
+	mono_profiler_set_thread_exited_callback(g_monoProfiler.handle, Profiler_ThreadExited);
+
+	/* Sampling has to be enabled before the runtime starts. The sampler stays idle until
+	 * profileCalls sets a sample mode */
+	if (mono_profiler_enable_sampling(g_monoProfiler.handle))
+		mono_profiler_set_sample_hit_callback(g_monoProfiler.handle, Profiler_SampleHit);
+
+	/* Same for allocation events. Nothing is recorded until profileAllocations is set */
+	if (settings.allocationProfiling) {
+		g_allocationEvents = mono_profiler_enable_allocations();
+		if (!g_allocationEvents)
+			printf("Failed to enable allocation profiling\n");
+	}
+
+	/* The filter keeps everything outside of script assemblies uninstrumented */
+	mono_profiler_set_call_instrumentation_filter_callback(g_monoProfiler.handle, Profiler_CallFilter);
+	mono_profiler_set_method_enter_callback(g_monoProfiler.handle, Profiler_MethodEnter);
+	mono_profiler_set_method_leave_callback(g_monoProfiler.handle, Profiler_MethodLeave);
+	mono_profiler_set_method_exception_leave_callback(g_monoProfiler.handle, Profiler_MethodExceptionLeave);
 
 	/* Register our memory allocator for mono */
 	if (!settings._malloc)
@@ -954,17 +2545,38 @@ ManagedScriptSystem::ManagedScriptSystem(ManagedScriptSystemSettings_t settings)
 		ASSERT(0);
 		abort();
 	}
+
+	/* Resolve the commonly used system classes up front so they never need a search */
+	const std::pair<const char*, MonoClass*> wellKnown[] = {
+		{"Object", mono_get_object_class()},	   {"String", mono_get_string_class()},
+		{"Exception", mono_get_exception_class()}, {"Boolean", mono_get_boolean_class()},
+		{"Char", mono_get_char_class()},		   {"Byte", mono_get_byte_class()},
+		{"SByte", mono_get_sbyte_class()},		   {"Int16", mono_get_int16_class()},
+		{"UInt16", mono_get_uint16_class()},	   {"Int32", mono_get_int32_class()},
+		{"UInt32", mono_get_uint32_class()},	   {"Int64", mono_get_int64_class()},
+		{"UInt64", mono_get_uint64_class()},	   {"Single", mono_get_single_class()},
+		{"Double", mono_get_double_class()},	   {"IntPtr", mono_get_intptr_class()},
+		{"UIntPtr", mono_get_uintptr_class()},	   {"Void", mono_get_void_class()},
+		{"Array", mono_get_array_class()},
+	};
+	std::lock_guard<std::mutex> lock(g_systemClassLock);
+	auto& systemNs = g_systemClasses["System"];
+	for (auto& kv : wellKnown) {
+		if (kv.second)
+			systemNs[kv.first] = kv.second;
+	}
 }
 
 ManagedScriptSystem::~ManagedScriptSystem() {
 	for (auto c : m_contexts) {
 		delete (c);
 	}
+	GCHandlePool::Shutdown();
 	mono_jit_cleanup(g_jitDomain);
 }
 
 ManagedScriptContext* ManagedScriptSystem::CreateContext(const char* image) {
-	ManagedScriptContext* ctx = new ManagedScriptContext(image);
+	ManagedScriptContext* ctx = new ManagedScriptContext(image, m_settings);
 
 	if (!ctx->Init()) {
 		delete ctx;
@@ -998,11 +2610,39 @@ void ManagedScriptSystem::RegisterNativeFunction(const char* name, void* func) {
 }
 
 void ManagedScriptSystem::ReportProfileStats() {
-	MonoProfiler* prof = &g_monoProfiler;
+	ManagedProfilingData_t total = TotalProfilingData();
 	printf("---- MONO PROFILE REPORT ----\n");
 	printf("Total Allocations: %lu\nBytes Allocated: %lu\nTotal Moves: "
 		   "%lu\nBytes Moved: %lu\n",
-		   prof->totalAllocs, prof->bytesAlloc, prof->totalMoves, prof->bytesMoved);
+		   (unsigned long)total.totalAllocs, (unsigned long)total.bytesAlloc, (unsigned long)total.totalMoves,
+		   (unsigned long)total.bytesMoved);
+
+	if (g_sampleRing) {
+		auto samples = GetMethodSamples();
+		printf("Hot Methods (self/total samples, %lu dropped):\n", (unsigned long)DroppedSamples());
+		for (size_t i = 0; i < samples.size() && i < 10; i++) {
+			printf("  %8lu %8lu  %s\n", (unsigned long)samples[i].selfSamples, (unsigned long)samples[i].totalSamples,
+				   samples[i].name.c_str());
+		}
+	}
+
+	if (m_profilingSettings.profileAllocations) {
+		printf("Top Allocating Classes (count, bytes):\n");
+		for (auto& stats : GetAllocationsByClass(10))
+			printf("  %10lu %12lu  %s\n", (unsigned long)stats.count, (unsigned long)stats.bytes, stats.name.c_str());
+		printf("Top Allocating Methods (count, bytes):\n");
+		for (auto& stats : GetAllocationsByMethod(10))
+			printf("  %10lu %12lu  %s\n", (unsigned long)stats.count, (unsigned long)stats.bytes, stats.name.c_str());
+	}
+
+	if (m_profilingSettings.instrumentCalls) {
+		auto timings = GetMethodTimings();
+		printf("Instrumented Methods (calls, exclusive/inclusive ms):\n");
+		for (size_t i = 0; i < timings.size() && i < 10; i++) {
+			printf("  %8lu %10.3f %10.3f  %s\n", (unsigned long)timings[i].calls, timings[i].exclusiveNs / 1e6,
+				   timings[i].inclusiveNs / 1e6, timings[i].name.c_str());
+		}
+	}
 }
 
 uint32_t ManagedScriptSystem::MaxGCGeneration() {
@@ -1020,22 +2660,62 @@ void ManagedScriptSystem::RunGCCollectAll() {
 }
 
 void ManagedScriptSystem::PushProfilingContext() {
-	m_profilingData.push(ManagedProfilingData_t());
-	m_curFrame = &m_profilingData.top();
+	ThreadProfilingState_t* state = ProfilingState();
+	if (!state)
+		return;
+	std::lock_guard<std::mutex> lock(state->lock);
+	state->frames.emplace_back(new ProfilingShard_t());
+	state->current = state->frames.back().get();
 }
 
 void ManagedScriptSystem::PopProfilingContext() {
+	ThreadProfilingState_t* state = ProfilingState();
+	if (!state)
+		return;
+	std::lock_guard<std::mutex> lock(state->lock);
 	/* There should always be at least one frame in the stack */
-	if (m_profilingData.size() > 1) {
-		m_profilingData.pop();
-		m_curFrame = &m_profilingData.top();
+	if (state->frames.size() > 1) {
+		ManagedProfilingData_t popped = state->current->Snapshot();
+		state->frames.pop_back();
+		state->current = state->frames.back().get();
+		state->current->Add(popped);
 	}
 }
 
+ManagedProfilingData_t ManagedScriptSystem::CurrentProfilingData() {
+	ThreadProfilingState_t* state = ProfilingState();
+	return state ? state->current->Snapshot() : ManagedProfilingData_t();
+}
+
+ManagedProfilingData_t ManagedScriptSystem::TotalProfilingData() {
+	std::lock_guard<std::mutex> lock(g_profilingThreadLock);
+	ManagedProfilingData_t total = g_retiredProfilingData;
+	for (auto* state : g_profilingThreads) {
+		std::lock_guard<std::mutex> stateLock(state->lock);
+		for (auto& frame : state->frames)
+			AddProfilingData(total, frame->Snapshot());
+	}
+	return total;
+}
+
 void ManagedScriptSystem::SetProfilingSettings(ManagedProfilingSettings_t settings) {
 	m_profilingSettings = settings;
-	if (m_profilingSettings.profileAllocations) {
-		mono_profiler_enable_allocations();
+	if (m_profilingSettings.profileAllocations && !g_allocationEvents) {
+		printf("profileAllocations requires allocationProfiling in the script system settings\n");
+		m_profilingSettings.profileAllocations = false;
+	}
+
+	g_profileAllocations.store(m_profilingSettings.profileAllocations);
+	g_instrumentCalls.store(m_profilingSettings.instrumentCalls);
+	g_allocSampleBytes.store(m_profilingSettings.allocationSampleBytes);
+
+	if (m_profilingSettings.profileCalls) {
+		if (!g_sampleRing)
+			g_sampleRing = new RawSample_t[SAMPLE_RING_SIZE]();
+		uint32_t freq = m_profilingSettings.sampleFrequency ? m_profilingSettings.sampleFrequency : 100;
+		mono_profiler_set_sample_mode(g_monoProfiler.handle, MONO_PROFILER_SAMPLE_MODE_PROCESS, freq);
+	} else {
+		mono_profiler_set_sample_mode(g_monoProfiler.handle, MONO_PROFILER_SAMPLE_MODE_NONE, 0);
 	}
 }
 
@@ -1043,37 +2723,90 @@ static void Profiler_RuntimeInit(MonoProfiler* prof) {
 }
 
 static void Profiler_RuntimeShutdownStart(MonoProfiler* prof) {
-	auto& ctx = prof->scriptsys->CurrentProfilingData();
 }
 
 static void Profiler_RuntimeShutdownEnd(MonoProfiler* prof) {
-	auto& ctx = prof->scriptsys->CurrentProfilingData();
 }
 
 static void Profiler_ContextLoaded(MonoProfiler* prof, MonoAppContext* _ctx) {
-	auto& ctx = prof->scriptsys->CurrentProfilingData();
-	ctx.totalContextLoads++;
+	if (ThreadProfilingState_t* state = ProfilingState())
+		BumpCounter(state->current->totalContextLoads, 1);
 }
 
 static void Profiler_ContextUnloaded(MonoProfiler* prof, MonoAppContext* _ctx) {
-	auto& ctx = prof->scriptsys->CurrentProfilingData();
-	ctx.totalContextUnloads++;
+	if (ThreadProfilingState_t* state = ProfilingState())
+		BumpCounter(state->current->totalContextUnloads, 1);
 }
 
 static void Profiler_GCEvent(MonoProfiler* prof, MonoProfilerGCEvent ev, uint32_t gen, mono_bool isSerial) {
-	auto& ctx = prof->scriptsys->CurrentProfilingData();
 }
 
 static void Profiler_GCAlloc(MonoProfiler* prof, MonoObject* obj) {
-	auto& ctx = prof->scriptsys->CurrentProfilingData();
-	ctx.bytesAlloc += mono_object_get_size(obj);
-	ctx.totalAllocs++;
+	if (!g_profileAllocations.load(std::memory_order_relaxed))
+		return;
+
+	ThreadProfilingState_t* state = ProfilingState();
+	if (!state)
+		return;
+	MonoClass* cls = mono_object_get_class(obj);
+	size_t size = AllocationSize(*state, obj, cls);
+	ProfilingShard_t& shard = *state->current;
+	BumpCounter(shard.bytesAlloc, size);
+	BumpCounter(shard.totalAllocs, 1);
+	RecordAllocation(*state, cls, size);
 }
 
 static void Profiler_GCResize(MonoProfiler* prof, uintptr_t size) {
-	auto& ctx = prof->scriptsys->CurrentProfilingData();
-	ctx.totalMoves++;
-	ctx.bytesMoved += size;
+	ThreadProfilingState_t* state = ProfilingState();
+	if (!state)
+		return;
+	BumpCounter(state->current->totalMoves, 1);
+	BumpCounter(state->current->bytesMoved, size);
+}
+
+static void Profiler_AssemblyLoaded(MonoProfiler* prof, MonoAssembly* ass) {
+	/* Classes we previously failed to find might be in the new assembly */
+	std::lock_guard<std::mutex> lock(g_systemClassLock);
+	for (auto& ns : g_systemClasses) {
+		for (auto it = ns.second.begin(); it != ns.second.end();) {
+			if (!it->second)
+				it = ns.second.erase(it);
+			else
+				++it;
+		}
+	}
+}
+
+static void Profiler_AssemblyUnloading(MonoProfiler* prof, MonoAssembly* ass) {
+	/* Drop everything that came from the unloading image */
+	MonoImage* img = mono_assembly_get_image(ass);
+	{
+		std::lock_guard<std::mutex> lock(g_systemClassLock);
+		for (auto& ns : g_systemClasses) {
+			for (auto it = ns.second.begin(); it != ns.second.end();) {
+				if (it->second && mono_class_get_image(it->second) == img)
+					it = ns.second.erase(it);
+				else
+					++it;
+			}
+		}
+	}
+	PurgeAllocationStats(img);
+}
+
+static void Profiler_ThreadStarted(MonoProfiler* prof, uintptr_t tid) {
+	/* Host threads may attach and detach once per job, so each attach starts recording again */
+	t_profilingRetired = false;
+}
+
+static void Profiler_ThreadExited(MonoProfiler* prof, uintptr_t tid) {
+	/* Raised on the exiting or detaching thread as the last thing it does in the runtime. Its
+	 * buffered calls and counters are folded into the global totals */
+	t_profilingRetired = true;
+	delete t_callBuffer;
+	t_callBuffer = nullptr;
+	delete t_profilingState;
+	t_profilingState = nullptr;
 }
 
 } // namespace mono
\ No newline at end of file
@@ -1,14 +1,25 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <functional>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <stack>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 /* Mono includes */
@@ -20,6 +31,20 @@
 #include <mono/metadata/mono-gc.h>
 #include <mono/metadata/object.h>
 
+/* Calling convention used by thunks from mono_method_get_unmanaged_thunk */
+#if defined(_WIN32) && !defined(_WIN64)
+#define MONO_THUNK_CALL __stdcall
+#else
+#define MONO_THUNK_CALL
+#endif
+
+/* Hint that addr is about to be read */
+#if defined(__GNUC__) || defined(__clang__)
+#define MONO_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define MONO_PREFETCH(addr) ((void)(addr))
+#endif
+
 namespace mono {
 
 template <class T> class ManagedBase;
@@ -75,6 +100,88 @@ struct ManagedException_t
 	std::string string_rep; // String representation of the exception (object.ToString)
 };
 
+/* Property getters of an exception class, looked up once per class */
+struct ManagedExceptionClass_t
+{
+	bool isException; // Derives from System.Exception
+	MonoMethod* messageGetter;
+	MonoMethod* sourceGetter;
+	MonoMethod* stackTraceGetter;
+};
+
+//==============================================================================================//
+// ManagedExceptionDesc
+//      Lazy version of ManagedException_t. Each field is read from the exception the first
+//      time it's accessed. Only valid while the exception object is alive
+//==============================================================================================//
+class ManagedExceptionDesc
+{
+private:
+	MonoObject* m_exception;
+	const ManagedExceptionClass_t* m_class;
+
+	enum : uint8_t
+	{
+		MESSAGE = 1,
+		STACK_TRACE = 2,
+		SOURCE = 4,
+		STRING_REP = 8,
+	};
+	mutable uint8_t m_loaded = 0;
+	mutable std::string m_message;
+	mutable std::string m_stackTrace;
+	mutable std::string m_source;
+	mutable std::string m_stringRep;
+
+	const std::string& GetString(uint8_t field, MonoMethod* getter, std::string& out) const;
+
+public:
+	ManagedExceptionDesc(MonoObject* exception, const ManagedExceptionClass_t* cls)
+		: m_exception(exception), m_class(cls) {
+	}
+
+	/* False if the object isn't a System.Exception, in which case all fields are empty */
+	bool Valid() const {
+		return m_class && m_class->isException;
+	}
+
+	MonoObject* RawException() const {
+		return m_exception;
+	}
+
+	const std::string& Message() const;
+	const std::string& StackTrace() const;
+	const std::string& Source() const;
+	const std::string& StringRep() const; // object.ToString
+	const char* ClassName() const;
+	const char* Namespace() const;
+
+	/* Reads every field */
+	ManagedException_t Materialize() const;
+};
+
+enum class EExceptionDelivery
+{
+	/* Callbacks run on the thread that reported the exception */
+	IMMEDIATE = 0,
+	/* Reports are queued and delivered by ManagedScriptContext::PumpExceptions */
+	PUMPED,
+	/* Reports are queued and delivered on a worker thread owned by the context */
+	WORKER,
+};
+
+/* Exceptions of one class thrown out of one method during an aggregation interval */
+struct ManagedExceptionSummary_t
+{
+	class ManagedAssembly* assembly;
+	MonoClass* klass;
+	MonoMethod* method; // Method invoked from native code that threw, may be null
+	uint64_t count;
+	std::chrono::steady_clock::time_point firstSeen;
+	std::chrono::steady_clock::time_point lastSeen;
+	ManagedException_t first; // Descriptor of the first exception in the interval
+};
+
 //==============================================================================================//
 // ManagedBase
 //      base class for all Managed types
@@ -120,6 +227,169 @@ protected:
 	}
 };
 
+//==============================================================================================//
+// NameIndex
+//      Flat, open-addressed lookup table from a member name to the member. Keys are
+//      std::string_view so lookups never construct temporary strings
+//==============================================================================================//
+template <class T> class NameIndex
+{
+private:
+	struct Slot_t
+	{
+		uint32_t hash;
+		T* value;
+	};
+
+	std::vector<Slot_t> m_slots;
+	size_t m_mask = 0;
+
+public:
+	/* FNV-1a */
+	static uint32_t Hash(std::string_view name) {
+		uint32_t hash = 2166136261u;
+		for (char c : name) {
+			hash ^= (uint8_t)c;
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	/* Rebuilds the index. If several items share a name, the first one wins */
+	void Build(const std::vector<T*>& items) {
+		size_t capacity = 8;
+		while (capacity < items.size() * 2)
+			capacity <<= 1;
+		m_slots.assign(capacity, Slot_t{0, nullptr});
+		m_mask = capacity - 1;
+
+		for (auto item : items) {
+			std::string_view name = item->Name();
+			uint32_t hash = Hash(name);
+			size_t i = hash & m_mask;
+			for (; m_slots[i].value; i = (i + 1) & m_mask) {
+				if (m_slots[i].hash == hash && m_slots[i].value->Name() == name)
+					break;
+			}
+			if (!m_slots[i].value)
+				m_slots[i] = {hash, item};
+		}
+	}
+
+	T* Find(std::string_view name) const {
+		if (m_slots.empty())
+			return nullptr;
+		uint32_t hash = Hash(name);
+		for (size_t i = hash & m_mask; m_slots[i].value; i = (i + 1) & m_mask) {
+			if (m_slots[i].hash == hash && m_slots[i].value->Name() == name)
+				return m_slots[i].value;
+		}
+		return nullptr;
+	}
+
+	void Clear() {
+		m_slots.clear();
+		m_mask = 0;
+	}
+};
+
+//==============================================================================================//
+// MpscQueue
+//      Unbounded lock-free queue for many producers and a single consumer. Push never
+//      blocks; Pop must only be called from one thread at a time
+//==============================================================================================//
+template <class T> class MpscQueue
+{
+private:
+	struct Node
+	{
+		std::atomic<Node*> next{nullptr};
+		T value;
+	};
+
+	std::atomic<Node*> m_head; // Last pushed node, producers swap themselves in here
+	Node* m_tail;			   // Already consumed node, its successor is the next to pop
+
+public:
+	MpscQueue() {
+		m_tail = new Node();
+		m_head.store(m_tail, std::memory_order_relaxed);
+	}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	~MpscQueue() {
+		T discard;
+		while (Pop(discard))
+			;
+		delete m_tail;
+	}
+
+	void Push(T&& value) {
+		Node* node = new Node();
+		node->value = std::move(value);
+		Node* prev = m_head.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	/* Returns false if the queue is empty, or if a producer is midway through a push */
+	bool Pop(T& out) {
+		Node* next = m_tail->next.load(std::memory_order_acquire);
+		if (!next)
+			return false;
+		out = std::move(next->value);
+		delete m_tail;
+		m_tail = next;
+		return true;
+	}
+};
+
+//==============================================================================================//
+// ReflectionArena
+//      Bump allocator for the reflection objects of an assembly. Objects are packed into
+//      large blocks, and are all destroyed and freed at once when the arena is reset
+//==============================================================================================//
+class ReflectionArena
+{
+private:
+	struct Destructor_t
+	{
+		void* object;
+		void (*destroy)(void* object);
+	};
+
+	std::vector<char*> m_blocks;
+	char* m_cur = nullptr;
+	size_t m_remaining = 0;
+	std::vector<Destructor_t> m_destructors;
+	std::mutex m_lock; // Classes may be populated from several threads
+
+public:
+	static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+	ReflectionArena() = default;
+	ReflectionArena(const ReflectionArena&) = delete;
+	ReflectionArena(ReflectionArena&&) = delete;
+
+	~ReflectionArena() {
+		Reset();
+	}
+
+	void* Allocate(size_t size, size_t align);
+
+	/* Constructed outside of the lock, since constructors allocate their own members from the arena */
+	template <class T, class... Args> T* New(Args&&... args) {
+		T* obj = new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_destructors.push_back({obj, [](void* o) { static_cast<T*>(o)->~T(); }});
+		return obj;
+	}
+
+	/* Destroys everything in reverse order of creation, and frees all blocks */
+	void Reset();
+};
+
 //==============================================================================================//
 // ManagedAssembly
 //      Represents an Assembly object
@@ -133,7 +403,8 @@ private:
 	MonoAssembly* m_assembly;
 	MonoImage* m_image;
 	std::string m_path;
-	std::unordered_multimap<std::string, class ManagedClass*> m_classes;
+	std::unordered_multimap<std::string_view, class ManagedClass*> m_classes; // Keyed on namespace
+	ReflectionArena m_arena; // Owns all reflection objects of this assembly
 	bool m_populated;
 	class ManagedScriptContext* m_ctx;
 
@@ -152,11 +423,17 @@ protected:
 	friend class ManagedMethod;
 
 	void PopulateReflectionInfo();
+	void PopulateReflectionInfoParallel(const MonoTableInfo* tab, int rows, int numThreads);
 	void DisposeReflectionInfo();
 
 public:
 	void GetReferencedTypes(std::vector<std::string>& refList);
 
+	/* Lists the "namespace.class" names of all types defined in this assembly */
+	/* Reads the metadata tables directly, so this doesn't create any reflection info */
+	void GetDefinedTypes(std::vector<std::string>& typeList);
+	int NumDefinedTypes() const;
+
 	bool ValidateAgainstWhitelist(const std::vector<std::string>& whiteList);
 
 	/* Invalidates all internal data and unloads the assembly */
@@ -164,7 +441,7 @@ public:
 	void Unload();
 	void InvalidateHandle() override;
 
-	inline void ReportException(MonoObject* exc);
+	inline void ReportException(MonoObject* exc, MonoMethod* method = nullptr);
 };
 
 //==============================================================================================//
@@ -189,6 +466,7 @@ public:
 protected:
 	ManagedType(MonoType* type);
 
+	friend class ReflectionArena;
 	friend class ManagedMethod;
 	friend class ManagedObject;
 
@@ -242,6 +520,38 @@ enum class EManagedObjectHandleType
 	 * obtain the actual object's address on access
 	 */
 	WEAKREF = 2,
+	/**
+	 * Strong reference stored in a slot of the shared GCHandlePool. Creating
+	 * and releasing these doesn't touch the runtime's handle table. The object
+	 * isn't pinned, but accesses are a single load from the pool slot
+	 */
+	POOLED = 3,
+};
+
+//==============================================================================================//
+// GCHandlePool
+//      Strong references kept in slots of pinned object[] slabs. Each slab costs a single
+//      runtime GC handle, and released slots are recycled through a free list
+//==============================================================================================//
+class GCHandlePool
+{
+public:
+	static constexpr uint32_t SLAB_SIZE = 4096;
+	static constexpr uint32_t MAX_SLABS = 4096;
+
+	/* Stores obj in a free slot, and returns the slot index */
+	static uint32_t Acquire(MonoObject* obj);
+	static void Release(uint32_t slot);
+
+	/* The address of a slot never changes, and the GC keeps its contents up to date */
+	/* This doesn't take the pool lock */
+	static MonoObject** SlotAddress(uint32_t slot);
+
+	/* Makes sure at least count slots can be acquired without creating new slabs */
+	static void Reserve(uint32_t count);
+
+	/* Frees all slabs. Any slots still in use become invalid, and releasing them does nothing */
+	static void Shutdown();
 };
 
 //==============================================================================================//
@@ -251,16 +561,15 @@ enum class EManagedObjectHandleType
 //      It's just a wrapper around a MonoObject.
 //==============================================================================================//
 using ManagedObjectHandle = uint32_t;
-class ManagedObject : public ManagedBase<ManagedObject>
+class ManagedObject final : public ManagedBase<ManagedObject>
 {
 private:
 	MonoObject* m_obj;
 	class ManagedClass* m_class;
-	uint32_t m_gcHandle = 0;
+	uint32_t m_gcHandle = 0; // Slot index for POOLED objects
+	MonoObject** m_slot = nullptr;
 	EManagedObjectHandleType m_handleType = EManagedObjectHandleType::HANDLE_PINNED;
 
-	std::function<MonoObject*()> m_getObject;
-
 	friend class ManagedClass;
 	friend class ManagedMethod;
 	friend class ManagedScriptContext;
@@ -274,18 +583,40 @@ public:
 						   EManagedObjectHandleType type = EManagedObjectHandleType::HANDLE_PINNED);
 	~ManagedObject();
 
+	/* ManagedObjects are recycled through a free list instead of the general heap */
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr, size_t size);
+
 	const ManagedClass& Class() const {
 		return *m_class;
 	}
 
+	/* Pinned objects can't move, so their address is used directly. Everything else
+	 * has to ask mono where the object currently lives */
 	const MonoObject* RawObject() const {
-		return m_getObject();
+		if (m_handleType == EManagedObjectHandleType::HANDLE_PINNED)
+			return m_obj;
+		if (m_handleType == EManagedObjectHandleType::POOLED)
+			return *m_slot;
+		return mono_gchandle_get_target(m_gcHandle);
 	};
 	MonoObject* RawObject() {
-		return m_getObject();
+		if (m_handleType == EManagedObjectHandleType::HANDLE_PINNED)
+			return m_obj;
+		if (m_handleType == EManagedObjectHandleType::POOLED)
+			return *m_slot;
+		return mono_gchandle_get_target(m_gcHandle);
 	};
 
+	/* Only valid for objects backed by a runtime GC handle. Pooled objects have a slot instead */
 	ManagedObjectHandle GCHandle() {
+		assert(m_handleType != EManagedObjectHandleType::POOLED);
+		return m_gcHandle;
+	};
+
+	/* GCHandlePool slot of a POOLED object */
+	uint32_t PoolSlot() {
+		assert(m_handleType == EManagedObjectHandleType::POOLED);
 		return m_gcHandle;
 	};
 
@@ -298,14 +629,145 @@ public:
 	bool GetProperty(class ManagedProperty& prop, void** outValue);
 	bool GetField(class ManagedField& prop, void* outValue);
 
-	bool SetProperty(const std::string& p, void* value);
-	bool SetField(const std::string& p, void* value);
-	bool GetProperty(const std::string& p, void** outValue);
-	bool GetField(const std::string& p, void* outValue);
+	bool SetProperty(std::string_view p, void* value);
+	bool SetField(std::string_view p, void* value);
+	bool GetProperty(std::string_view p, void** outValue);
+	bool GetField(std::string_view p, void* outValue);
 
 	MonoObject* Invoke(class ManagedMethod* method, void** params);
 };
 
+//==============================================================================================//
+// ObjectRef
+//      8 byte, trivially copyable reference to a managed object, for storing lots of references
+//      in native data. Copies share the same handle: Acquire and Release are explicit, and
+//      every copy is invalid once any of them is released
+//==============================================================================================//
+class ObjectRef
+{
+private:
+	uint32_t m_handle;
+	uint32_t m_type; // EManagedObjectHandleType, or UINT32_MAX if null
+
+	static constexpr uint32_t NULL_TYPE = UINT32_MAX;
+
+public:
+	ObjectRef() : m_handle(0), m_type(NULL_TYPE) {
+	}
+
+	static ObjectRef Acquire(MonoObject* obj, EManagedObjectHandleType type = EManagedObjectHandleType::POOLED);
+	void Release();
+
+	bool Valid() const {
+		return m_type != NULL_TYPE;
+	}
+
+	EManagedObjectHandleType HandleType() const {
+		return (EManagedObjectHandleType)m_type;
+	}
+
+	/* A GCHandlePool slot for POOLED refs, a runtime GC handle otherwise */
+	uint32_t Handle() const {
+		return m_handle;
+	}
+
+	/* Returns nullptr for null refs, and for weak refs whose object has been collected */
+	MonoObject* Resolve() const;
+
+	/* Creates a ManagedObject with its own handle to the referenced object */
+	ManagedObject* CreateManagedObject(class ManagedClass& cls,
+									   EManagedObjectHandleType type = EManagedObjectHandleType::HANDLE_PINNED) const;
+
+	bool operator==(const ObjectRef& other) const {
+		return m_handle == other.m_handle && m_type == other.m_type;
+	}
+	bool operator!=(const ObjectRef& other) const {
+		return !(*this == other);
+	}
+};
+
+static_assert(sizeof(ObjectRef) == 8, "ObjectRef must stay 8 bytes");
+static_assert(std::is_trivially_copyable_v<ObjectRef>, "ObjectRef must be trivially copyable");
+
+//==============================================================================================//
+// NativeType
+//      Describes how a C++ type is passed to or returned from managed code through a thunk
+//==============================================================================================//
+struct NativeTypeDesc_t
+{
+	/* MONO_TYPE_PTR matches any reference or pointer type, MONO_TYPE_VALUETYPE any struct of
+	 * the same size. Everything else must match the managed primitive type */
+	MonoTypeEnum type;
+	uint32_t size;
+};
+
+/* Trivially copyable structs must match the managed struct's size. C++ enums are treated as
+ * their underlying type */
+template <class T> struct NativeType
+{
+	static constexpr NativeTypeDesc_t Desc() {
+		if constexpr (std::is_enum_v<T>) {
+			return NativeType<std::underlying_type_t<T>>::Desc();
+		} else {
+			static_assert(std::is_trivially_copyable_v<T>, "Type cannot be passed to managed code by value");
+			return {MONO_TYPE_VALUETYPE, sizeof(T)};
+		}
+	}
+};
+
+/* MonoObject*, MonoString*, MonoArray* etc. for reference types, void* for IntPtr */
+template <class T> struct NativeType<T*>
+{
+	static constexpr NativeTypeDesc_t Desc() {
+		return {MONO_TYPE_PTR, sizeof(T*)};
+	}
+};
+
+template <> struct NativeType<void>
+{
+	static constexpr NativeTypeDesc_t Desc() {
+		return {MONO_TYPE_VOID, 0};
+	}
+};
+
+#define MONO_NATIVE_TYPE(_type, _monoType)                                                                             \
+	template <> struct NativeType<_type>                                                                               \
+	{                                                                                                                  \
+		static constexpr NativeTypeDesc_t Desc() {                                                                     \
+			return {_monoType, sizeof(_type)};                                                                         \
+		}                                                                                                              \
+	};
+
+MONO_NATIVE_TYPE(bool, MONO_TYPE_BOOLEAN)
+MONO_NATIVE_TYPE(char16_t, MONO_TYPE_CHAR)
+MONO_NATIVE_TYPE(int8_t, MONO_TYPE_I1)
+MONO_NATIVE_TYPE(uint8_t, MONO_TYPE_U1) /* Also matches MonoBoolean */
+MONO_NATIVE_TYPE(int16_t, MONO_TYPE_I2)
+MONO_NATIVE_TYPE(uint16_t, MONO_TYPE_U2) /* Also matches mono_unichar2 */
+MONO_NATIVE_TYPE(int32_t, MONO_TYPE_I4)
+MONO_NATIVE_TYPE(uint32_t, MONO_TYPE_U4)
+MONO_NATIVE_TYPE(int64_t, MONO_TYPE_I8)
+MONO_NATIVE_TYPE(uint64_t, MONO_TYPE_U8)
+MONO_NATIVE_TYPE(float, MONO_TYPE_R4)
+MONO_NATIVE_TYPE(double, MONO_TYPE_R8)
+
+#undef MONO_NATIVE_TYPE
+
+/* Returns the managed class of a primitive native type, or nullptr for structs and pointers */
+MonoClass* NativeTypeClass(const NativeTypeDesc_t& desc);
+
+/* Pointer types match arrays of references. Anything else matches arrays of the same primitive,
+ * enum or reference-free struct */
+bool MatchElementClass(MonoClass* elementClass, const NativeTypeDesc_t& desc);
+bool MatchArrayElementType(MonoArray* array, const NativeTypeDesc_t& desc);
+
+/* Unmanaged thunks take and return structs boxed, as MonoObject*. Everything else is passed as is */
+template <class T> constexpr bool IsBoxedNativeType = NativeType<T>::Desc().type == MONO_TYPE_VALUETYPE;
+template <class T> using ThunkType = std::conditional_t<IsBoxedNativeType<T>, MonoObject*, T>;
+
+template <class Sig> class TypedMethod;
+template <class Sig> class BatchMethod;
+
 //==============================================================================================//
 // ManagedMethod
 //      Represents a MonoMethod object, must be a part of a class
@@ -320,15 +782,18 @@ private:
 	MonoMethodSignature* m_signature;
 	bool m_populated;
 	uint32_t m_token;
-	std::string m_name;
-	std::string m_fullyQualifiedName;
+	std::string_view m_name; // Points into the image's string heap
 	int m_paramCount;
 
 	ManagedType* m_returnType;
 	std::vector<ManagedType*> m_params;
 
+	void* m_thunk;
+
 	friend class ManagedClass;
 	friend ManagedHandle<ManagedMethod>;
+	template <class Sig> friend class TypedMethod;
+	template <class Sig> friend class BatchMethod;
 
 public:
 	ManagedMethod() = delete;
@@ -343,9 +808,12 @@ protected:
 	friend class ExecutionContext;
 	friend class ManagedClass;
 	friend class ManagedObject;
+	friend class ReflectionArena;
 
 	void InvalidateHandle() override;
 
+	void ReportException(MonoObject* exc);
+
 public:
 	ManagedAssembly& Assembly() const;
 
@@ -355,7 +823,7 @@ public:
 		return m_attributes;
 	}
 
-	const std::string& Name() const {
+	std::string_view Name() const {
 		return m_name;
 	};
 
@@ -371,8 +839,129 @@ public:
 	bool MatchSignature(std::vector<MonoType*> params);
 	bool MatchSignature();
 
+	/* Checks a native signature against the managed one. types[0] is the return type. If classes
+	 * isn't null, it receives the class of each struct type, and nullptr for everything else */
+	bool MatchNativeSignature(const NativeTypeDesc_t* types, size_t count, MonoClass** classes = nullptr) const;
+
+	/* Checks that the method returns void and each parameter is an array whose elements match
+	 * types[i], see MatchElementClass. classes receives the element class of each parameter */
+	bool MatchArraySignature(const NativeTypeDesc_t* types, size_t count, MonoClass** classes) const;
+
+	bool IsStatic() const;
+
+	/* Returns the unmanaged thunk for this method, created on first use */
+	void* UnmanagedThunk();
+
 	MonoObject* Invoke(ManagedObject* obj, void** params, MonoObject** exception = nullptr);
 	MonoObject* InvokeStatic(void** params, MonoObject** exception = nullptr);
+
+	/* Binds this method to a native signature, e.g. Bind<float(int32_t, MonoString*)>() */
+	/* Check Valid() on the result, it's invalid if the signature doesn't match */
+	template <class Sig> TypedMethod<Sig> Bind() {
+		return TypedMethod<Sig>(*this);
+	}
+
+	/* Binds this method as the trampoline of a BatchMethod, e.g. BindBatch<void(float)>() */
+	template <class Sig> BatchMethod<Sig> BindBatch() {
+		return BatchMethod<Sig>(*this);
+	}
+};
+
+//==============================================================================================//
+// TypedMethod
+//      Calls a ManagedMethod through its unmanaged thunk. The signature is validated once
+//      when bound, after which calls skip mono_runtime_invoke. Primitives, enums and references
+//      are passed as is and never allocate. The thunk only takes and returns structs boxed, so
+//      each struct argument or return value costs a managed allocation.
+//      To call a method on many objects in one transition, see BatchMethod.
+//      A binding points at its ManagedMethod, so rebind after ClearReflectionInfo or after
+//      unloading the method's assembly
+//==============================================================================================//
+template <class R, class... Args> class TypedMethod<R(Args...)>
+{
+private:
+	using StaticThunkT = ThunkType<R>(MONO_THUNK_CALL*)(ThunkType<Args>..., MonoException**);
+	using InstanceThunkT = ThunkType<R>(MONO_THUNK_CALL*)(MonoObject*, ThunkType<Args>..., MonoException**);
+
+	ManagedMethod* m_method;
+	void* m_thunk;
+	bool m_static;
+	MonoClass* m_classes[sizeof...(Args) + 1]; // Classes of struct types for boxing, [0] is the return type
+
+	template <class T> ThunkType<T> ToThunk(const T& value, MonoClass* cls) const {
+		if constexpr (IsBoxedNativeType<T>)
+			return mono_value_box(mono_domain_get(), cls, const_cast<T*>(&value));
+		else
+			return value;
+	}
+
+	template <class ThunkT, class... CallArgs> R Call(ThunkT thunk, CallArgs... args) const {
+		MonoException* exc = nullptr;
+		if constexpr (std::is_void_v<R>) {
+			thunk(args..., &exc);
+			if (exc)
+				m_method->ReportException(reinterpret_cast<MonoObject*>(exc));
+		} else {
+			ThunkType<R> ret = thunk(args..., &exc);
+			if (exc) {
+				m_method->ReportException(reinterpret_cast<MonoObject*>(exc));
+				return R();
+			}
+			if constexpr (IsBoxedNativeType<R>) {
+				R value{};
+				if (ret)
+					memcpy(&value, mono_object_unbox(ret), sizeof(R));
+				return value;
+			} else {
+				return ret;
+			}
+		}
+	}
+
+	template <size_t... I> R InvokeImpl(std::index_sequence<I...>, MonoObject* obj, Args... args) const {
+		return Call(reinterpret_cast<InstanceThunkT>(m_thunk), obj, ToThunk<Args>(args, m_classes[I + 1])...);
+	}
+
+	template <size_t... I> R InvokeStaticImpl(std::index_sequence<I...>, Args... args) const {
+		return Call(reinterpret_cast<StaticThunkT>(m_thunk), ToThunk<Args>(args, m_classes[I + 1])...);
+	}
+
+public:
+	TypedMethod() : m_method(nullptr), m_thunk(nullptr), m_static(false), m_classes() {
+	}
+
+	explicit TypedMethod(ManagedMethod& method)
+		: m_method(&method), m_thunk(nullptr), m_static(method.IsStatic()), m_classes() {
+		const NativeTypeDesc_t types[] = {NativeType<R>::Desc(), NativeType<Args>::Desc()...};
+		if (method.MatchNativeSignature(types, sizeof(types) / sizeof(types[0]), m_classes))
+			m_thunk = method.UnmanagedThunk();
+	}
+
+	bool Valid() const {
+		return m_thunk != nullptr;
+	}
+
+	bool IsStatic() const {
+		return m_static;
+	}
+
+	ManagedMethod* Method() const {
+		return m_method;
+	}
+
+	R Invoke(MonoObject* obj, Args... args) const {
+		assert(Valid() && !m_static);
+		return InvokeImpl(std::index_sequence_for<Args...>(), obj, args...);
+	}
+
+	R Invoke(ManagedObject* obj, Args... args) const {
+		return Invoke(obj->RawObject(), args...);
+	}
+
+	R InvokeStatic(Args... args) const {
+		assert(Valid() && m_static);
+		return InvokeStaticImpl(std::index_sequence_for<Args...>(), args...);
+	}
 };
 
 //==============================================================================================//
@@ -384,7 +973,7 @@ class ManagedField : public ManagedBase<ManagedField>
 private:
 	MonoClassField& m_field;
 	class ManagedClass& m_class;
-	std::string m_name;
+	std::string_view m_name; // Points into the image's string heap
 
 public:
 	ManagedField() = delete;
@@ -398,10 +987,27 @@ public:
 	inline MonoClassField& RawField() const {
 		return m_field;
 	};
-	const std::string& Name() const {
+	std::string_view Name() const {
 		return m_name;
 	}
 
+	MonoType* RawType() const {
+		return mono_field_get_type(&m_field);
+	}
+
+	/* Offset from the start of the object, including the object header */
+	uint32_t Offset() const {
+		return mono_field_get_offset(&m_field);
+	}
+
+	bool IsStatic() const;
+
+	/* True if the field is a reference, or a struct that contains references. Writes to
+	 * these need a GC write barrier */
+	bool HasReferences() const;
+
+	bool MatchNativeType(const NativeTypeDesc_t& desc) const;
+
 protected:
 	explicit ManagedField(MonoClassField& fld, class ManagedClass& cls);
 	~ManagedField();
@@ -409,8 +1015,296 @@ protected:
 	friend class ManagedClass;
 	friend class ManagedProperty;
 	friend class ManagedObject;
+	friend class ReflectionArena;
+};
+
+//==============================================================================================//
+// FieldAccessor
+//      Reads and writes an instance field directly at its cached offset, instead of going
+//      through mono_field_get_value/mono_field_set_value. Check Valid() after binding, it's
+//      invalid for static fields or if T doesn't match the field type
+//==============================================================================================//
+template <class T> class FieldAccessor
+{
+private:
+	uint32_t m_offset;
+	MonoClass* m_valueClass; // Set for structs that contain references
+	bool m_valid : 1;
+	bool m_hasRefs : 1;
+
+	/* Objects are resolved a chunk at a time, and their fields prefetched before copying */
+	static constexpr size_t BULK_CHUNK = 64;
+
+	template <class GetObjectT> void GatherImpl(size_t count, GetObjectT getObject, T* out) const {
+		assert(m_valid);
+		char* addrs[BULK_CHUNK];
+		for (size_t base = 0; base < count; base += BULK_CHUNK) {
+			size_t n = std::min(count - base, BULK_CHUNK);
+			for (size_t i = 0; i < n; i++) {
+				MonoObject* obj = getObject(base + i);
+				addrs[i] = obj ? reinterpret_cast<char*>(Address(obj)) : nullptr;
+				if (addrs[i])
+					MONO_PREFETCH(addrs[i]);
+			}
+			for (size_t i = 0; i < n; i++) {
+				if (addrs[i])
+					memcpy(&out[base + i], addrs[i], sizeof(T));
+				else
+					out[base + i] = T();
+			}
+		}
+	}
+
+	template <class GetObjectT> void ScatterImpl(size_t count, GetObjectT getObject, const T* in) const {
+		assert(m_valid);
+		if (m_hasRefs) {
+			/* Every write needs a barrier */
+			for (size_t i = 0; i < count; i++) {
+				if (MonoObject* obj = getObject(i))
+					Set(obj, in[i]);
+			}
+			return;
+		}
+
+		char* addrs[BULK_CHUNK];
+		for (size_t base = 0; base < count; base += BULK_CHUNK) {
+			size_t n = std::min(count - base, BULK_CHUNK);
+			for (size_t i = 0; i < n; i++) {
+				MonoObject* obj = getObject(base + i);
+				addrs[i] = obj ? reinterpret_cast<char*>(Address(obj)) : nullptr;
+				if (addrs[i])
+					MONO_PREFETCH(addrs[i]);
+			}
+			for (size_t i = 0; i < n; i++) {
+				if (addrs[i])
+					memcpy(addrs[i], &in[base + i], sizeof(T));
+			}
+		}
+	}
+
+public:
+	FieldAccessor() : m_offset(0), m_valueClass(nullptr), m_valid(false), m_hasRefs(false) {
+	}
+
+	explicit FieldAccessor(ManagedField& field) : m_offset(field.Offset()), m_valueClass(nullptr) {
+		m_valid = !field.IsStatic() && field.MatchNativeType(NativeType<T>::Desc());
+		m_hasRefs = field.HasReferences();
+		if (m_hasRefs && !mono_type_is_reference(field.RawType()))
+			m_valueClass = mono_class_from_mono_type(field.RawType());
+		/* A reference can only be written through a pointer type, with a barrier */
+		if (m_hasRefs && !m_valueClass && !std::is_pointer_v<T>)
+			m_valid = false;
+	}
+
+	bool Valid() const {
+		return m_valid;
+	}
+
+	uint32_t Offset() const {
+		return m_offset;
+	}
+
+	/* Only stays valid while the object can't move, e.g. while it's pinned */
+	T* Address(MonoObject* obj) const {
+		return reinterpret_cast<T*>(reinterpret_cast<char*>(obj) + m_offset);
+	}
+
+	T Get(MonoObject* obj) const {
+		assert(m_valid);
+		T value;
+		memcpy(&value, Address(obj), sizeof(T));
+		return value;
+	}
+
+	T Get(ManagedObject& obj) const {
+		return Get(obj.RawObject());
+	}
+
+	void Set(MonoObject* obj, const T& value) const {
+		assert(m_valid);
+		if (!m_hasRefs) {
+			memcpy(Address(obj), &value, sizeof(T));
+		} else if (m_valueClass) {
+			mono_gc_wbarrier_value_copy(Address(obj), const_cast<T*>(&value), 1, m_valueClass);
+		} else {
+			if constexpr (std::is_pointer_v<T>)
+				mono_gc_wbarrier_set_field(obj, Address(obj), reinterpret_cast<MonoObject*>(value));
+		}
+	}
+
+	void Set(ManagedObject& obj, const T& value) const {
+		Set(obj.RawObject(), value);
+	}
+
+	/* Copies the field of each object into out[i]. Null objects read as T() */
+	void Gather(ManagedObject* const* objects, size_t count, T* out) const {
+		GatherImpl(
+			count, [objects](size_t i) { return objects[i] ? objects[i]->RawObject() : nullptr; }, out);
+	}
+
+	void Gather(const ObjectRef* objects, size_t count, T* out) const {
+		GatherImpl(
+			count, [objects](size_t i) { return objects[i].Resolve(); }, out);
+	}
+
+	/* Writes in[i] to the field of each object. Null objects are skipped */
+	void Scatter(ManagedObject* const* objects, size_t count, const T* in) const {
+		ScatterImpl(
+			count, [objects](size_t i) { return objects[i] ? objects[i]->RawObject() : nullptr; }, in);
+	}
+
+	void Scatter(const ObjectRef* objects, size_t count, const T* in) const {
+		ScatterImpl(
+			count, [objects](size_t i) { return objects[i].Resolve(); }, in);
+	}
+};
+
+//==============================================================================================//
+// ManagedArray
+//      Owns a GC handle to a MonoArray and gives direct access to its element storage. Pinned
+//      arrays can't move, so Data() stays valid for the lifetime of the wrapper. For unpinned
+//      arrays, Data() is only valid until the GC next gets a chance to run
+//==============================================================================================//
+template <class T> class ManagedArray
+{
+private:
+	MonoArray* m_array; // Only used when pinned
+	uint32_t m_gcHandle;
+	size_t m_length;
+	bool m_pinned;
+
+	static_assert(std::is_trivially_copyable_v<T>, "Array elements must be blittable");
+
+	ManagedArray(MonoArray* array, bool pinned)
+		: m_array(pinned ? array : nullptr), m_gcHandle(mono_gchandle_new((MonoObject*)array, pinned)),
+		  m_length(mono_array_length(array)), m_pinned(pinned) {
+	}
+
+public:
+	ManagedArray() : m_array(nullptr), m_gcHandle(0), m_length(0), m_pinned(false) {
+	}
+
+	ManagedArray(const ManagedArray&) = delete;
+	ManagedArray& operator=(const ManagedArray&) = delete;
+
+	ManagedArray(ManagedArray&& other) : ManagedArray() {
+		*this = std::move(other);
+	}
+
+	ManagedArray& operator=(ManagedArray&& other) {
+		std::swap(m_array, other.m_array);
+		std::swap(m_gcHandle, other.m_gcHandle);
+		std::swap(m_length, other.m_length);
+		std::swap(m_pinned, other.m_pinned);
+		return *this;
+	}
+
+	~ManagedArray() {
+		if (m_gcHandle)
+			mono_gchandle_free(m_gcHandle);
+	}
+
+	/* Wraps an existing array. Invalid if its element type doesn't match T, see MatchArrayElementType */
+	static ManagedArray Wrap(MonoArray* array, bool pinned = true) {
+		if (!array || !MatchArrayElementType(array, NativeType<T>::Desc()))
+			return ManagedArray();
+		return ManagedArray(array, pinned);
+	}
+
+	/* Creates a zeroed array. elementClass can be omitted for primitive T */
+	static ManagedArray Create(MonoDomain* domain, size_t length, MonoClass* elementClass = nullptr,
+							   bool pinned = true) {
+		if (!elementClass)
+			elementClass = NativeTypeClass(NativeType<T>::Desc());
+		if (!elementClass)
+			return ManagedArray();
+		return Wrap(mono_array_new(domain, elementClass, length), pinned);
+	}
+
+	/* Creates an array holding a copy of data */
+	static ManagedArray FromBuffer(MonoDomain* domain, const T* data, size_t length, MonoClass* elementClass = nullptr,
+								   bool pinned = true) {
+		ManagedArray array = Create(domain, length, elementClass, pinned);
+		if (array.Valid())
+			array.CopyFrom(data, length);
+		return array;
+	}
+
+	bool Valid() const {
+		return m_gcHandle != 0;
+	}
+
+	bool Pinned() const {
+		return m_pinned;
+	}
+
+	MonoArray* RawArray() const {
+		if (m_pinned)
+			return m_array;
+		return (MonoArray*)mono_gchandle_get_target(m_gcHandle);
+	}
+
+	size_t Length() const {
+		return m_length;
+	}
+
+	T* Data() const {
+		return reinterpret_cast<T*>(mono_array_addr_with_size(RawArray(), sizeof(T), 0));
+	}
+
+	T* begin() const {
+		return Data();
+	}
+
+	T* end() const {
+		return Data() + m_length;
+	}
+
+	T& operator[](size_t index) const {
+		assert(index < m_length);
+		return Data()[index];
+	}
+
+	/* Copies count elements from data, starting at element offset. References are copied with
+	 * a write barrier, everything else with a single memcpy */
+	void CopyFrom(const T* data, size_t count, size_t offset = 0) const {
+		assert(offset + count <= m_length);
+		if constexpr (std::is_pointer_v<T>)
+			mono_gc_wbarrier_arrayref_copy(Data() + offset, const_cast<T*>(data), (int)count);
+		else
+			memcpy(Data() + offset, data, count * sizeof(T));
+	}
+
+	void CopyTo(T* data, size_t count, size_t offset = 0) const {
+		assert(offset + count <= m_length);
+		memcpy(data, Data() + offset, count * sizeof(T));
+	}
 };
 
+//==============================================================================================//
+// String helpers
+//      Access MonoString contents without the allocations of mono_string_to_utf8
+//==============================================================================================//
+
+/* The UTF-16 contents of the string. Only valid while the string can't move */
+inline std::u16string_view StringChars(MonoString* str) {
+	if (!str)
+		return {};
+	return {reinterpret_cast<const char16_t*>(mono_string_chars(str)), (size_t)mono_string_length(str)};
+}
+
+/* Transcodes UTF-16 to UTF-8, replacing unpaired surrogates with U+FFFD. Returns the number of
+ * bytes written. If out is too small, conversion stops after the last character that fits.
+ * length * 3 bytes is always enough. The output isn't NUL terminated */
+size_t Utf16ToUtf8(const char16_t* in, size_t length, char* out, size_t outSize);
+
+/* Writes the string to out as NUL terminated UTF-8, returns the length without the terminator */
+size_t StringToUtf8(MonoString* str, char* out, size_t outSize);
+
+/* Converts the string into a thread local buffer. The view is valid until the next call on
+ * the same thread */
+std::string_view StringToUtf8(MonoString* str);
+
 //==============================================================================================//
 // ManagedProperty
 //      Represents a MonoProperty
@@ -420,7 +1314,7 @@ class ManagedProperty : public ManagedBase<ManagedProperty>
 private:
 	MonoProperty* m_property;
 	class ManagedClass& m_class;
-	std::string m_name;
+	std::string_view m_name; // Points into the image's string heap
 	MonoMethod* m_getMethod;
 	MonoMethod* m_setMethod;
 
@@ -436,6 +1330,7 @@ protected:
 	friend class ManagedClass;
 	friend class ManagedMethod;
 	friend class ManagedObject;
+	friend class ReflectionArena;
 
 public:
 	const MonoProperty* RawProperty() const {
@@ -445,6 +1340,190 @@ public:
 	const ManagedClass& Class() const {
 		return m_class;
 	}
+
+	std::string_view Name() const {
+		return m_name;
+	}
+
+	/* The ManagedMethods of the accessors, or nullptr if the property doesn't have one */
+	ManagedMethod* GetMethod() const;
+	ManagedMethod* SetMethod() const;
+
+	/* The compiler generated field behind an auto-property. nullptr for other properties, and
+	 * for overridable ones since an override may not use the field */
+	class ManagedField* BackingField() const;
+};
+
+//==============================================================================================//
+// PropertyAccessor
+//      Calls the getter and setter of an instance property through unmanaged thunks. Thunks
+//      box structs, so struct auto-properties read and write their backing field directly
+//      instead, which doesn't allocate. Other struct properties box on every access. Check
+//      CanGet()/CanSet() after binding
+//==============================================================================================//
+template <class T> class PropertyAccessor
+{
+private:
+	TypedMethod<T()> m_get;
+	TypedMethod<void(T)> m_set;
+	FieldAccessor<T> m_field; // Valid for struct auto-properties
+
+public:
+	PropertyAccessor() = default;
+
+	explicit PropertyAccessor(ManagedProperty& prop) {
+		if (ManagedMethod* get = prop.GetMethod())
+			m_get = get->Bind<T()>();
+		if (ManagedMethod* set = prop.SetMethod())
+			m_set = set->Bind<void(T)>();
+		if constexpr (IsBoxedNativeType<T>) {
+			if (ManagedField* field = prop.BackingField())
+				m_field = FieldAccessor<T>(*field);
+		}
+	}
+
+	bool CanGet() const {
+		return m_get.Valid() && !m_get.IsStatic();
+	}
+
+	bool CanSet() const {
+		return m_set.Valid() && !m_set.IsStatic();
+	}
+
+	/* Whether accesses skip the accessors and go straight to the backing field */
+	bool Direct() const {
+		return m_field.Valid();
+	}
+
+	T Get(MonoObject* obj) const {
+		if (m_field.Valid()) {
+			assert(CanGet());
+			return m_field.Get(obj);
+		}
+		return m_get.Invoke(obj);
+	}
+
+	T Get(ManagedObject& obj) const {
+		return Get(obj.RawObject());
+	}
+
+	void Set(MonoObject* obj, T value) const {
+		if (m_field.Valid()) {
+			assert(CanSet());
+			m_field.Set(obj, value);
+			return;
+		}
+		m_set.Invoke(obj, value);
+	}
+
+	void Set(ManagedObject& obj, T value) const {
+		Set(obj.RawObject(), value);
+	}
+};
+
+//==============================================================================================//
+// BatchMethod
+//      Calls a method on many objects in one native to managed transition. The loop runs in a
+//      static managed trampoline that takes the objects, the arguments and the results as
+//      arrays. For R Name(A1, A2) on class T it looks like this, without results for void:
+//
+//          static void NameBatch(T[] targets, A1[] a1, A2[] a2, R[] results, Exception[] errors) {
+//              for (int i = 0; i < targets.Length; i++) {
+//                  try { results[i] = targets[i].Name(a1[i], a2[i]); }
+//                  catch (Exception e) { errors[i] = e; }
+//              }
+//          }
+//
+//      Bind the trampoline as BatchMethod<R(A1, A2)>. Every batch allocates its arrays, so this
+//      pays off once there are more than a few objects per call
+//==============================================================================================//
+template <class R, class... Args> class BatchMethod<R(Args...)>
+{
+private:
+	template <class T> using ArrayParam = MonoArray*;
+	static constexpr size_t PARAM_COUNT = sizeof...(Args) + (std::is_void_v<R> ? 2 : 3);
+	using TrampolineT = std::conditional_t<std::is_void_v<R>,
+										   TypedMethod<void(MonoArray*, ArrayParam<Args>..., MonoArray*)>,
+										   TypedMethod<void(MonoArray*, ArrayParam<Args>..., MonoArray*, MonoArray*)>>;
+
+	ManagedMethod* m_method;
+	TrampolineT m_trampoline;
+	MonoClass* m_classes[PARAM_COUNT]; // Element class of each parameter
+
+	template <size_t... I>
+	size_t Run(std::index_sequence<I...>, MonoObject* const* objects, size_t count, const Args*... args,
+			   [[maybe_unused]] R* results, MonoObject** errors) const {
+		assert(Valid());
+		if (!count)
+			return 0;
+
+		/* Argument arrays only need to live until the call returns */
+		MonoDomain* domain = mono_domain_get();
+		auto targets = ManagedArray<MonoObject*>::FromBuffer(domain, objects, count, m_classes[0]);
+		auto excs = ManagedArray<MonoObject*>::Create(domain, count, m_classes[PARAM_COUNT - 1]);
+		if constexpr (std::is_void_v<R>) {
+			m_trampoline.InvokeStatic(
+				targets.RawArray(),
+				ManagedArray<Args>::FromBuffer(domain, args, count, m_classes[I + 1]).RawArray()...,
+				excs.RawArray());
+		} else {
+			auto out = ManagedArray<R>::Create(domain, count, m_classes[PARAM_COUNT - 2]);
+			m_trampoline.InvokeStatic(
+				targets.RawArray(),
+				ManagedArray<Args>::FromBuffer(domain, args, count, m_classes[I + 1]).RawArray()...,
+				out.RawArray(), excs.RawArray());
+			out.CopyTo(results, count);
+		}
+
+		size_t failed = 0;
+		for (size_t i = 0; i < count; i++) {
+			MonoObject* exc = excs[i];
+			if (exc)
+				failed++;
+			if (errors)
+				errors[i] = exc;
+			else if (exc)
+				m_method->ReportException(exc);
+		}
+		return failed;
+	}
+
+public:
+	BatchMethod() : m_method(nullptr), m_classes() {
+	}
+
+	explicit BatchMethod(ManagedMethod& trampoline) : m_method(&trampoline), m_classes() {
+		NativeTypeDesc_t types[PARAM_COUNT] = {};
+		size_t i = 0;
+		types[i++] = NativeType<MonoObject*>::Desc();
+		((types[i++] = NativeType<Args>::Desc()), ...);
+		if constexpr (!std::is_void_v<R>)
+			types[i++] = NativeType<R>::Desc();
+		types[i] = NativeType<MonoObject*>::Desc();
+
+		if (trampoline.IsStatic() && trampoline.MatchArraySignature(types, PARAM_COUNT, m_classes))
+			m_trampoline = TrampolineT(trampoline);
+	}
+
+	bool Valid() const {
+		return m_trampoline.Valid();
+	}
+
+	/* Calls the method on count objects. Each of args points to count arguments, one per object,
+	 * and results receives count return values. A throwing call doesn't stop the batch: errors[i]
+	 * receives the exception of objects[i] or null, and without errors the exceptions are
+	 * reported like any other. Returns how many calls threw. Exceptions in errors are only valid
+	 * until the runtime next runs, take an ObjectRef to keep one */
+	template <class RR = R, std::enable_if_t<!std::is_void_v<RR>, int> = 0>
+	size_t Invoke(MonoObject* const* objects, size_t count, const Args*... args, RR* results,
+				  MonoObject** errors = nullptr) const {
+		return Run(std::index_sequence_for<Args...>(), objects, count, args..., results, errors);
+	}
+
+	template <class RR = R, std::enable_if_t<std::is_void_v<RR>, int> = 0>
+	size_t Invoke(MonoObject* const* objects, size_t count, const Args*... args, MonoObject** errors = nullptr) const {
+		return Run(std::index_sequence_for<Args...>(), objects, count, args..., nullptr, errors);
+	}
 };
 
 //==============================================================================================//
@@ -459,8 +1538,12 @@ private:
 	std::vector<class ManagedObject*> m_attributes;
 	MonoCustomAttrInfo* m_attrInfo;
 	std::vector<class ManagedProperty*> m_properties;
-	std::string m_namespaceName;
-	std::string m_className;
+	NameIndex<class ManagedMethod> m_methodIndex;
+	NameIndex<class ManagedField> m_fieldIndex;
+	NameIndex<class ManagedProperty> m_propertyIndex;
+	/* Both point into the image's string heap */
+	std::string_view m_namespaceName;
+	std::string_view m_className;
 	MonoClass* m_class;
 	ManagedAssembly* m_assembly;
 	mono_byte m_numConstructors;
@@ -478,13 +1561,21 @@ private:
 	friend class ManagedMethod;
 	friend class ManagedAssembly;
 	friend class ManagedObject;
+	friend class ReflectionArena;
 
 protected:
 	ManagedClass(ManagedAssembly* assembly, const std::string& ns, const std::string& cls);
-	ManagedClass(ManagedAssembly* assembly, MonoClass* _cls, const std::string& ns, const std::string& cls);
+	ManagedClass(ManagedAssembly* assembly, MonoClass* _cls);
 	~ManagedClass();
 
 	void PopulateReflectionInfo();
+	void PopulateMembers();
+
+	/* Members are created on first use when the context uses lazy reflection */
+	void EnsureMembers() const {
+		if (!m_populated)
+			const_cast<ManagedClass*>(this)->PopulateMembers();
+	}
 
 	void InvalidateHandle() override;
 
@@ -493,22 +1584,26 @@ public:
 	ManagedClass(ManagedClass&& c) = delete;
 	ManagedClass(ManagedClass&) = delete;
 
-	const std::string& NamespaceName() const {
+	std::string_view NamespaceName() const {
 		return m_namespaceName;
 	};
-	const std::string& ClassName() const {
+	std::string_view ClassName() const {
 		return m_className;
 	};
 	const std::vector<class ManagedMethod*>& Methods() const {
+		EnsureMembers();
 		return m_methods;
 	};
 	const std::vector<class ManagedField*>& Fields() const {
+		EnsureMembers();
 		return m_fields;
 	};
 	const std::vector<class ManagedObject*>& Attributes() const {
+		EnsureMembers();
 		return m_attributes;
 	};
 	const std::vector<class ManagedProperty*>& Properties() const {
+		EnsureMembers();
 		return m_properties;
 	};
 	uint32_t DataSize() const {
@@ -532,9 +1627,13 @@ public:
 
 	mono_byte NumConstructors() const;
 
-	ManagedMethod* FindMethod(const std::string& name);
-	ManagedField* FindField(const std::string& name);
-	ManagedProperty* FindProperty(const std::string& prop);
+	/* If the method is overloaded, this returns the first overload */
+	ManagedMethod* FindMethod(std::string_view name);
+	ManagedField* FindField(std::string_view name);
+	ManagedProperty* FindProperty(std::string_view prop);
+
+	/* Finds the ManagedMethod wrapping a raw method of this class */
+	ManagedMethod* FindMethod(MonoMethod* method);
 
 	ManagedObject* CreateInstance(std::vector<MonoType*> signature, void** params);
 
@@ -579,20 +1678,88 @@ public:
 
 	friend class ManagedCompiler;
 	friend class ManagedClass;
+	friend class ManagedAssembly;
 
 	using ExceptionCallbackT =
 		std::function<void(ManagedScriptContext*, ManagedAssembly*, MonoObject*, ManagedException_t)>;
+	using LazyExceptionCallbackT =
+		std::function<void(ManagedScriptContext*, ManagedAssembly*, const ManagedExceptionDesc&)>;
+	using ExceptionSummaryCallbackT =
+		std::function<void(ManagedScriptContext*, const std::vector<ManagedExceptionSummary_t>&)>;
 
 protected:
 	std::vector<ExceptionCallbackT> m_callbacks;
+	std::vector<LazyExceptionCallbackT> m_lazyCallbacks;
+
+	/* Guards the exception class cache and the summaries, exceptions can be reported from any thread */
+	std::mutex m_exceptionLock;
+	std::unordered_map<MonoClass*, ManagedExceptionClass_t> m_exceptionClasses;
+	const ManagedExceptionClass_t* GetExceptionClass(MonoClass* cls);
+
+	/* Exception aggregation. Disabled when the interval is zero */
+	struct ExceptionKeyHash
+	{
+		size_t operator()(const std::pair<MonoClass*, MonoMethod*>& key) const {
+			return std::hash<void*>()(key.first) ^ (std::hash<void*>()(key.second) * 31);
+		}
+	};
+	std::atomic<std::chrono::milliseconds> m_exceptionInterval;
+	std::chrono::steady_clock::time_point m_lastExceptionFlush;
+	std::unordered_map<std::pair<MonoClass*, MonoMethod*>, ManagedExceptionSummary_t, ExceptionKeyHash>
+		m_exceptionSummaries;
+	std::vector<ExceptionSummaryCallbackT> m_summaryCallbacks;
+
+	void DeliverException(const ManagedExceptionDesc& desc, ManagedAssembly& ass);
+
+	/* Queued exception delivery */
+	struct QueuedException_t
+	{
+		ManagedAssembly* assembly;
+		ManagedException_t exc;
+	};
+	std::atomic<EExceptionDelivery> m_exceptionDelivery{EExceptionDelivery::IMMEDIATE};
+	MpscQueue<QueuedException_t> m_exceptionQueue;
+	std::recursive_mutex m_exceptionConsumerLock; // Held while popping from m_exceptionQueue
+	std::atomic<size_t> m_queuedExceptions{0};
+	std::thread m_exceptionWorker;
+	std::mutex m_exceptionWorkerLock;
+	std::condition_variable m_exceptionWorkerWake;
+	std::condition_variable m_exceptionQueueDrained; // Signaled when the queued count drops to zero
+	std::atomic<bool> m_exceptionWorkerStop{false};
+
+	size_t DrainExceptionQueue();
+	void WaitForExceptionQueue();
+	void FlushDueExceptionSummaries();
+
+	/* Class lookup cache keyed on ClassKey, plus names known not to exist in any loaded assembly */
+	std::unordered_map<std::string, ManagedClass*> m_classIndex;
+	std::unordered_set<std::string> m_missingClasses;
+	static constexpr size_t MISSING_CLASS_LIMIT = 1024;
+
+	bool m_lazyReflection;
+	int m_reflectionThreads;
+
+	/* Interned strings, most recently used at the front. The index keys point into the list nodes */
+	struct InternedString_t
+	{
+		std::string value;
+		ObjectRef ref;
+	};
+	std::list<InternedString_t> m_internedStrings;
+	std::unordered_map<std::string_view, std::list<InternedString_t>::iterator> m_internIndex;
+	size_t m_internLimit;
 
 	friend class ManagedScriptSystem;
 
-	explicit ManagedScriptContext(const std::string& baseImage);
+	explicit ManagedScriptContext(const std::string& baseImage, const struct ManagedScriptSystemSettings_t& settings);
 	~ManagedScriptContext();
 
 	void PopulateReflectionInfo();
 
+	/* Builds a lookup key in a per thread buffer, which is reused by the next call */
+	static const std::string& ClassKey(std::string_view ns, std::string_view cls);
+	void RemoveIndexedClasses(ManagedAssembly& assembly);
+
 public:
 	bool LoadAssembly(const char* path);
 
@@ -609,26 +1776,72 @@ public:
 
 	/* Returns a pointer to a raw MonoClass object corresponding to the
 	 * specified class */
-	/* This doesn't cache the class in a lookup table. You'll need to save the
-	 * class yourself */
+	/* Results are cached process-wide, and the cache is kept up to date as
+	 * assemblies are loaded and unloaded */
 	MonoClass* FindSystemClass(const std::string& ns, const std::string& cls);
 
 	ManagedAssembly* FindAssembly(const std::string& path);
 
 	ManagedException_t GetExceptionDescriptor(MonoObject* exception);
 
+	/* Returns a descriptor that only reads the fields it's asked for */
+	ManagedExceptionDesc DescribeException(MonoObject* exception);
+
+	/* Returns a long lived MonoString with the same contents, creating it on first use. Managed
+	 * strings are immutable, so the result can be passed to scripts any number of times. */
+	/* The least recently used strings are released once the limit from the settings is reached,
+	 * so don't hold on to the result across other InternString calls */
+	MonoString* InternString(std::string_view str);
+
+	/* Releases all interned strings */
+	void ClearInternedStrings();
+
 	/* Clears all reflection info stored in each assembly description */
 	/* WARNING: this will invalidate your handles! */
 	void ClearReflectionInfo();
 
 	bool ValidateAgainstWhitelist(const std::vector<std::string>& whitelist);
 
-	void ReportException(MonoObject& obj, ManagedAssembly& ass);
+	/* method is the method that was invoked from native code, used to group exceptions
+	 * when aggregation is enabled */
+	void ReportException(MonoObject& obj, ManagedAssembly& ass, MonoMethod* method = nullptr);
+
+	/* Enables exception aggregation. Only the first exception of each class thrown out of
+	 * each method is passed to the exception callbacks, the rest are counted and delivered
+	 * to the summary callbacks once per interval. Zero disables aggregation */
+	/* Summaries are flushed by the next report after the interval, by the WORKER thread, or
+	 * by PumpExceptions. Call PumpExceptions periodically in IMMEDIATE mode too, so the last
+	 * counts of a burst aren't held until the next exception */
+	void SetExceptionAggregation(std::chrono::milliseconds interval);
+
+	/* Delivers pending summaries now */
+	void FlushExceptionSummaries();
+
+	/* Chooses where ExceptionCallbackT callbacks run. Descriptors are materialized on the
+	 * reporting thread either way, but queued callbacks get a null MonoObject since the
+	 * exception may be gone by the time they run. Lazy callbacks always run immediately.
+	 * Summary callbacks run wherever summaries are flushed, see SetExceptionAggregation.
+	 * Register callbacks before switching to WORKER */
+	void SetExceptionDelivery(EExceptionDelivery mode);
+
+	/* Delivers queued reports on the calling thread in PUMPED mode, and summaries whose interval
+	 * has passed in PUMPED and IMMEDIATE modes. Returns how many reports were delivered */
+	size_t PumpExceptions();
+
+	void RegisterExceptionSummaryCallback(ExceptionSummaryCallbackT callback) {
+		m_summaryCallbacks.push_back(callback);
+	}
 
 	void RegisterExceptionCallback(ExceptionCallbackT callback) {
 		m_callbacks.push_back(callback);
 	}
 
+	/* Lazy callbacks only pay for the fields they read. The descriptor must not be kept
+	 * after the callback returns */
+	void RegisterLazyExceptionCallback(LazyExceptionCallbackT callback) {
+		m_lazyCallbacks.push_back(callback);
+	}
+
 	MonoDomain* RawDomain() const {
 		return m_domain;
 	};
@@ -649,6 +1862,26 @@ struct ManagedScriptSystemSettings_t
 	 * this is raw text data from the cfg file */
 	const char* configData;
 
+	/* If true, classes and their members are only created when first looked up,
+	 * instead of for every type when an assembly is loaded */
+	bool lazyReflection;
+
+	/* Number of worker threads used to create reflection info when an assembly is
+	 * loaded. 1 creates it on the calling thread */
+	int reflectionThreads;
+
+	/* Maximum number of strings each context keeps in its intern table */
+	size_t internedStringLimit;
+
+	/* Exception aggregation interval for new contexts in milliseconds, 0 disables it.
+	 * See ManagedScriptContext::SetExceptionAggregation */
+	uint32_t exceptionAggregationMs;
+
+	/* Enables allocation events, which ManagedProfilingSettings_t::profileAllocations needs. Mono
+	 * only allows this before the runtime starts, and it disables the fast allocation paths for
+	 * the life of the process */
+	bool allocationProfiling;
+
 	/* Overrides for the default mono allocators */
 	void* (*_malloc)(size_t size);
 	void* (*_realloc)(void* mem, size_t count);
@@ -661,6 +1894,11 @@ struct ManagedScriptSystemSettings_t
 		_free = nullptr;
 		_calloc = nullptr;
 		configIsFile = true;
+		lazyReflection = false;
+		reflectionThreads = 1;
+		internedStringLimit = 1024;
+		exceptionAggregationMs = 0;
+		allocationProfiling = false;
 		configData = "";
 		scriptSystemDomainName = "";
 	}
@@ -693,16 +1931,55 @@ struct ManagedProfilingSettings_t
 	bool profileThread : 1;		 /* Profile threading events */
 	bool recordThreadEvents : 1; /* Log thread start/stop events in a
 									timestamped log */
+
+	/* Samples per second taken when profileCalls is set. 0 uses mono's default of 100 */
+	uint32_t sampleFrequency;
+
+	/* Instrument every method in script assemblies to record exact call counts and times.
+	 * Methods are instrumented when they're compiled, so set this before running scripts */
+	bool instrumentCalls;
+
+	/* With profileAllocations, attribute on average one allocation per this many bytes to its
+	 * class and allocating method, and scale the results up. 0 attributes every allocation,
+	 * which walks the stack each time. Totals are always exact */
+	uint32_t allocationSampleBytes;
+};
+
+/* Allocations of one class, or from one method. Estimates when allocation sampling is on */
+struct ManagedAllocationStats_t
+{
+	MonoClass* klass;	// Set for per class stats
+	MonoMethod* method; // Set for per method stats, null for allocations without a managed caller
+	std::string name;
+	uint64_t count;
+	uint64_t bytes;
+};
+
+/* Sampling profiler results for one method */
+struct ManagedMethodSamples_t
+{
+	MonoMethod* method;
+	std::string name;
+	uint64_t selfSamples;  // Samples where this method was the innermost managed frame
+	uint64_t totalSamples; // Samples where this method was anywhere on the stack
+};
+
+/* Call instrumentation results for one method */
+struct ManagedMethodTiming_t
+{
+	MonoMethod* method;
+	std::string name;
+	uint64_t calls;
+	uint64_t inclusiveNs; // Time including callees
+	uint64_t exclusiveNs; // Time minus instrumented callees
 };
 
 class ManagedScriptSystem
 {
 private:
 	std::vector<ManagedScriptContext*> m_contexts;
-	std::stack<ManagedProfilingData_t> m_profilingData;
 	MonoAllocatorVTable m_allocator;
 	ManagedScriptSystemSettings_t m_settings;
-	ManagedProfilingData_t* m_curFrame;
 	bool m_debugEnabled;
 	ManagedProfilingSettings_t m_profilingSettings;
 
@@ -731,6 +2008,38 @@ public:
 
 	void ReportProfileStats();
 
+	/* Symbolizes samples taken since the last call. The functions below do this too, but
+	 * calling it periodically keeps the sample buffer from filling up and dropping samples */
+	void CollectSamples();
+
+	/* Per method sample counts, sorted by self samples */
+	std::vector<ManagedMethodSamples_t> GetMethodSamples();
+
+	/* Stacks in the folded "outer;inner;leaf count" format used by flamegraph tools */
+	std::string GetFoldedStacks();
+
+	/* Number of samples dropped because the buffer was full */
+	uint64_t DroppedSamples() const;
+
+	void ResetSamples();
+
+	/* Per method call counts and times from instrumentCalls, sorted by exclusive time. Calls are
+	 * recorded in per-thread buffers which are published in blocks. The calling thread's buffer
+	 * is published first, other threads' recent calls may not be included yet */
+	std::vector<ManagedMethodTiming_t> GetMethodTimings();
+
+	/* Publishes the calls the calling thread has buffered. Call it from threads that run a few
+	 * scripts and then go idle, so their calls show up in GetMethodTimings */
+	void FlushCallEvents();
+
+	void ResetMethodTimings();
+
+	/* Allocations from profileAllocations, sorted by bytes. topN of 0 returns everything */
+	std::vector<ManagedAllocationStats_t> GetAllocationsByClass(size_t topN = 0);
+	std::vector<ManagedAllocationStats_t> GetAllocationsByMethod(size_t topN = 0);
+
+	void ResetAllocationStats();
+
 	void EnableDebugging(bool enable);
 	bool IsDebuggingEnabled() const {
 		return m_debugEnabled;
@@ -745,11 +2054,16 @@ public:
 	void RunGCCollect(uint32_t gen);
 	void RunGCCollectAll();
 
+	/* Profiling frames are per thread. Counters go to the calling thread's innermost frame,
+	 * and a popped frame's counts are added to its parent. There's always a root frame */
 	void PushProfilingContext();
 	void PopProfilingContext();
-	inline ManagedProfilingData_t& CurrentProfilingData() {
-		return *m_curFrame;
-	}; // This needs to be fast
+
+	/* Counters of the calling thread's current frame */
+	ManagedProfilingData_t CurrentProfilingData();
+
+	/* Counters of every thread, including threads that have exited */
+	ManagedProfilingData_t TotalProfilingData();
 };
 
 } // namespace mono
\ No newline at end of file
@@ -2,11 +2,23 @@ using System;
 
 namespace WrapperTests
 {
+	public struct Vector3
+	{
+		public float x, y, z;
+	}
+
 	public class TestClass
 	{
 		public string value;
 		public bool boolean;
 		public int integer;
+
+		public Vector3 Position { get; set; }
+
+		public int Scale(int factor)
+		{
+			return integer * factor;
+		}
 	}
 	
 	public class WrapperTestClass
@@ -41,5 +53,20 @@ namespace WrapperTests
 		{
 			throw new Exception("AAAAAAAAAAAAAA");
 		}
+
+		public static void ScaleBatch(TestClass[] targets, int[] factors, int[] results, Exception[] errors)
+		{
+			for (int i = 0; i < targets.Length; i++)
+			{
+				try
+				{
+					results[i] = targets[i].Scale(factors[i]);
+				}
+				catch (Exception e)
+				{
+					errors[i] = e;
+				}
+			}
+		}
 	}
 }
\ No newline at end of file
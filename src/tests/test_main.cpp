@@ -40,6 +40,12 @@ static void RunBasicTest(TestContext_t&);
 static void RunSimpleReturnTest(TestContext_t&);
 static void RunObjectTest(TestContext_t&);
 static void RunComplexObjectTest(TestContext_t&);
+static void RunTypedMethodTest(TestContext_t&);
+static void RunFieldAccessorTest(TestContext_t&);
+static void RunPropertyAccessorTest(TestContext_t&);
+static void RunBatchMethodTest(TestContext_t&);
+static void RunManagedArrayTest(TestContext_t&);
+static void RunStringTest(TestContext_t&);
 static void LoadTestDLL(TestContext_t&);
 
 int main(int argc, char** argv) {
@@ -79,6 +85,12 @@ int main(int argc, char** argv) {
 	RunSimpleReturnTest(context);
 	RunObjectTest(context);
 	RunComplexObjectTest(context);
+	RunTypedMethodTest(context);
+	RunFieldAccessorTest(context);
+	RunPropertyAccessorTest(context);
+	RunBatchMethodTest(context);
+	RunManagedArrayTest(context);
+	RunStringTest(context);
 }
 
 static void LoadTestDLL(TestContext_t& context) {
@@ -149,3 +161,219 @@ static void RunObjectTest(TestContext_t& context) {
 
 static void RunComplexObjectTest(TestContext_t& context) {
 }
+
+static void RunTypedMethodTest(TestContext_t& context) {
+	const char* curTest = "WrapperTest.WrapperTestClass.Test1";
+
+	auto badBind = context.test1MethodStatic->Bind<int32_t(int32_t)>();
+	if (badBind.Valid())
+		REPORT_FAIL("%s bound with a mismatched signature", curTest);
+	else
+		REPORT_PASS("%s mismatched signature rejected", curTest);
+
+	auto test1 = context.test1MethodStatic->Bind<MonoBoolean()>();
+	if (!test1.Valid()) {
+		REPORT_FAIL("%s failed to bind typed method", curTest);
+		return;
+	}
+
+	if (test1.InvokeStatic() != 1)
+		REPORT_FAIL("%s typed return check fail", curTest);
+	else
+		REPORT_PASS("%s typed return check OK", curTest);
+}
+
+static void RunFieldAccessorTest(TestContext_t& context) {
+	const char* curTest = "WrapperTests.TestClass.integer";
+
+	context.testClass = context.scriptContext->FindClass("WrapperTests", "TestClass");
+	if (!context.testClass) {
+		REPORT_FAIL("Failed to find WrapperTests.TestClass");
+		return;
+	}
+
+	ManagedField* field = context.testClass->FindField("integer");
+	if (!field) {
+		REPORT_FAIL("%s field lookup failed", curTest);
+		return;
+	}
+
+	FieldAccessor<float> badAccessor(*field);
+	if (badAccessor.Valid())
+		REPORT_FAIL("%s bound with a mismatched type", curTest);
+	else
+		REPORT_PASS("%s mismatched type rejected", curTest);
+
+	ManagedObject* obj = context.testClass->CreateInstance({}, nullptr);
+	if (!obj) {
+		REPORT_FAIL("Failed to create WrapperTests.TestClass");
+		return;
+	}
+
+	FieldAccessor<int32_t> accessor(*field);
+	accessor.Set(*obj, 1234);
+
+	int32_t value = 0;
+	obj->GetField(*field, &value);
+	if (!accessor.Valid() || accessor.Get(*obj) != 1234 || value != 1234)
+		REPORT_FAIL("%s accessor read/write check fail", curTest);
+	else
+		REPORT_PASS("%s accessor read/write check OK", curTest);
+
+	delete obj;
+}
+
+/* Matches WrapperTests.Vector3 */
+struct Vector3_t
+{
+	float x, y, z;
+};
+
+static void RunPropertyAccessorTest(TestContext_t& context) {
+	const char* curTest = "WrapperTests.TestClass.Position";
+
+	if (!context.testClass) {
+		REPORT_FAIL("%s needs WrapperTests.TestClass", curTest);
+		return;
+	}
+
+	ManagedProperty* prop = context.testClass->FindProperty("Position");
+	if (!prop) {
+		REPORT_FAIL("%s property lookup failed", curTest);
+		return;
+	}
+
+	PropertyAccessor<Vector3_t> accessor(*prop);
+	if (!accessor.CanGet() || !accessor.CanSet()) {
+		REPORT_FAIL("%s failed to bind struct accessor", curTest);
+		return;
+	}
+
+	/* Auto-property, so it shouldn't box through the accessors */
+	if (!accessor.Direct())
+		REPORT_FAIL("%s struct accessor doesn't use the backing field", curTest);
+	else
+		REPORT_PASS("%s struct accessor uses the backing field", curTest);
+
+	ManagedObject* obj = context.testClass->CreateInstance({}, nullptr);
+	if (!obj) {
+		REPORT_FAIL("Failed to create WrapperTests.TestClass");
+		return;
+	}
+
+	accessor.Set(*obj, {1.5f, -2.0f, 3.25f});
+	Vector3_t value = accessor.Get(*obj);
+	if (value.x != 1.5f || value.y != -2.0f || value.z != 3.25f)
+		REPORT_FAIL("%s struct round trip fail", curTest);
+	else
+		REPORT_PASS("%s struct round trip OK", curTest);
+
+	delete obj;
+}
+
+static void RunBatchMethodTest(TestContext_t& context) {
+	const char* curTest = "WrapperTests.WrapperTestClass.ScaleBatch";
+
+	ManagedMethod* method = context.wrapperTestClass->FindMethod("ScaleBatch");
+	ManagedField* field = context.testClass ? context.testClass->FindField("integer") : nullptr;
+	if (!method || !field) {
+		REPORT_FAIL("%s lookup failed", curTest);
+		return;
+	}
+
+	if (method->BindBatch<int32_t(float)>().Valid())
+		REPORT_FAIL("%s bound with a mismatched signature", curTest);
+	else
+		REPORT_PASS("%s mismatched signature rejected", curTest);
+
+	auto batch = method->BindBatch<int32_t(int32_t)>();
+	if (!batch.Valid()) {
+		REPORT_FAIL("%s failed to bind batch method", curTest);
+		return;
+	}
+
+	/* The null target throws, which must not stop the others */
+	ManagedObject* first = context.testClass->CreateInstance({}, nullptr);
+	ManagedObject* last = context.testClass->CreateInstance({}, nullptr);
+	FieldAccessor<int32_t> integer(*field);
+	integer.Set(*first, 2);
+	integer.Set(*last, 5);
+
+	MonoObject* objects[] = {first->RawObject(), nullptr, last->RawObject()};
+	int32_t factors[] = {3, 4, 5};
+	int32_t results[3] = {};
+	MonoObject* errors[3] = {};
+	size_t failed = batch.Invoke(objects, 3, factors, results, errors);
+
+	if (failed != 1 || !errors[1] || errors[0] || errors[2] || results[0] != 6 || results[2] != 25)
+		REPORT_FAIL("%s per object results check fail", curTest);
+	else
+		REPORT_PASS("%s per object results check OK", curTest);
+
+	delete first;
+	delete last;
+}
+
+static void RunManagedArrayTest(TestContext_t& context) {
+	const char* curTest = "ManagedArray<int32_t>";
+
+	int32_t data[16];
+	for (int i = 0; i < 16; i++)
+		data[i] = i * 3;
+
+	auto array = ManagedArray<int32_t>::FromBuffer(context.scriptContext->RawDomain(), data, 16);
+	if (!array.Valid() || array.Length() != 16) {
+		REPORT_FAIL("%s failed to create array", curTest);
+		return;
+	}
+
+	bool match = mono_array_length(array.RawArray()) == 16;
+	for (int i = 0; i < 16; i++)
+		match = match && array[i] == data[i];
+
+	if (!match)
+		REPORT_FAIL("%s contents check fail", curTest);
+	else
+		REPORT_PASS("%s contents check OK", curTest);
+
+	auto wrongSize = ManagedArray<int64_t>::Wrap(array.RawArray());
+	if (wrongSize.Valid())
+		REPORT_FAIL("%s wrapped with a mismatched element size", curTest);
+	else
+		REPORT_PASS("%s mismatched element size rejected", curTest);
+
+	/* Same size as a reference on 64-bit, but must not be copied into reference slots */
+	MonoArray* objects = mono_array_new(context.scriptContext->RawDomain(), mono_get_object_class(), 4);
+	if (ManagedArray<int64_t>::Wrap(objects).Valid() || !ManagedArray<MonoObject*>::Wrap(objects).Valid())
+		REPORT_FAIL("%s reference element check fail", curTest);
+	else
+		REPORT_PASS("%s reference element check OK", curTest);
+}
+
+static void RunStringTest(TestContext_t& context) {
+	const char* curTest = "StringToUtf8";
+
+	/* Long enough to take the vectorized path, with multibyte characters past it */
+	const char* text = "ascii fast path \xC3\xA9\xE2\x82\xAC \xF0\x9F\x98\x80";
+	MonoString* str = mono_string_new(context.scriptContext->RawDomain(), text);
+
+	if (StringToUtf8(str) != text)
+		REPORT_FAIL("%s round trip mismatch", curTest);
+	else
+		REPORT_PASS("%s round trip OK", curTest);
+
+	char small[8];
+	size_t len = StringToUtf8(str, small, sizeof(small));
+	if (len != 7 || strncmp(small, text, 7) != 0 || small[7] != 0)
+		REPORT_FAIL("%s truncation fail", curTest);
+	else
+		REPORT_PASS("%s truncation OK", curTest);
+
+	curTest = "InternString";
+	MonoString* first = context.scriptContext->InternString("event.name");
+	MonoString* second = context.scriptContext->InternString(std::string("event.name"));
+	if (!first || first != second || StringToUtf8(first) != "event.name")
+		REPORT_FAIL("%s did not return the cached string", curTest);
+	else
+		REPORT_PASS("%s cached string OK", curTest);
+}